@@ -0,0 +1,147 @@
+#include <math.h>
+#include "anchor_select.h"
+
+/* Horizontal distance from the position to an anchor. */
+static double hrange(const Anchor *a, const Position *pos)
+{
+    return sqrt((a->x - pos->x) * (a->x - pos->x) + (a->y - pos->y) * (a->y - pos->y));
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn anchor_hdop()
+ *
+ * @brief Horizontal dilution of precision of a set of anchors seen from a position: sqrt(trace((H^T H)^-1)) where the rows of H are the unit
+ *        vectors from the anchors to the position. Two-way ranging has no clock bias term, so H only has the x and y columns.
+ *
+ * @param  tab  anchor table
+ * @param  idx  indexes in tab of the anchors in the set
+ * @param  k    number of anchors in the set
+ * @param  pos  position of the tag
+ *
+ * @return HDOP, or HUGE_VAL if the set cannot give a position (fewer than 2 directions, or all collinear with the tag)
+ */
+double anchor_hdop(const Anchor *tab, const uint8_t *idx, int k, const Position *pos)
+{
+    double hxx = 0, hxy = 0, hyy = 0, det;
+    int i;
+
+    for (i = 0; i < k; i++)
+    {
+        const Anchor *a = &tab[idx[i]];
+        double r = hrange(a, pos);
+        double ex, ey;
+
+        if (r < ANCHOR_SEL_MIN_RANGE_M)
+            continue;
+        ex = (pos->x - a->x) / r;
+        ey = (pos->y - a->y) / r;
+        hxx += ex * ex;
+        hxy += ex * ey;
+        hyy += ey * ey;
+    }
+
+    det = hxx * hyy - hxy * hxy;
+    if (det < 1e-6)
+        return HUGE_VAL;
+    return sqrt((hxx + hyy) / det);
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn anchor_select()
+ *
+ * @brief Pick up to k anchors to range with. The best 3 are found by trying every triple of candidates, then anchors are added one at a time,
+ *        each time the one that lowers the HDOP most. With n up to TRILAT_MAX_ANCHORS this is at most a few hundred small HDOP evaluations, done
+ *        once per fix. Without a position (pos NULL) the first k available anchors are returned.
+ *
+ * @param  tab    anchor table
+ * @param  n      number of anchors in the table
+ * @param  avail  bit i set if anchor i can be used (e.g. it answered recently)
+ * @param  pos    last position of the tag, or NULL if unknown
+ * @param  k      number of anchors wanted, 3 or more
+ * @param  sel    output, indexes in tab of the anchors chosen (k entries)
+ *
+ * @return number of anchors chosen, fewer than k if not enough candidates
+ */
+int anchor_select(const Anchor *tab, int n, uint32_t avail, const Position *pos, int k, uint8_t *sel)
+{
+    uint8_t cand[TRILAT_MAX_ANCHORS], best[3];
+    double best_dop = HUGE_VAL;
+    int n_cand = 0, n_sel, i, j, m;
+
+    if (n > TRILAT_MAX_ANCHORS)
+        n = TRILAT_MAX_ANCHORS;
+    for (i = 0; i < n; i++)
+    {
+        if (!(avail & (1UL << i)))
+            continue;
+        if (pos && hrange(&tab[i], pos) > ANCHOR_SEL_MAX_RANGE_M)
+            continue;
+        cand[n_cand++] = (uint8_t)i;
+    }
+
+    if (!pos || n_cand <= k || n_cand < 3)
+    {
+        n_sel = (n_cand < k) ? n_cand : k;
+        for (i = 0; i < n_sel; i++)
+            sel[i] = cand[i];
+        return n_sel;
+    }
+
+    /* Best triple. */
+    best[0] = cand[0];
+    best[1] = cand[1];
+    best[2] = cand[2];
+    for (i = 0; i < n_cand; i++)
+    {
+        for (j = i + 1; j < n_cand; j++)
+        {
+            for (m = j + 1; m < n_cand; m++)
+            {
+                uint8_t t[3];
+                double dop;
+
+                t[0] = cand[i];
+                t[1] = cand[j];
+                t[2] = cand[m];
+                dop = anchor_hdop(tab, t, 3, pos);
+                if (dop < best_dop)
+                {
+                    best_dop = dop;
+                    best[0] = t[0];
+                    best[1] = t[1];
+                    best[2] = t[2];
+                }
+            }
+        }
+    }
+    sel[0] = best[0];
+    sel[1] = best[1];
+    sel[2] = best[2];
+    n_sel = 3;
+
+    /* Greedy additions. */
+    while (n_sel < k)
+    {
+        int best_i = -1;
+
+        best_dop = HUGE_VAL;
+        for (i = 0; i < n_cand; i++)
+        {
+            double dop;
+
+            for (j = 0; j < n_sel && sel[j] != cand[i]; j++)
+                ;
+            if (j < n_sel)
+                continue;
+            sel[n_sel] = cand[i];
+            dop = anchor_hdop(tab, sel, n_sel + 1, pos);
+            if (best_i < 0 || dop < best_dop)
+            {
+                best_dop = dop;
+                best_i = i;
+            }
+        }
+        sel[n_sel++] = cand[best_i];
+    }
+    return n_sel;
+}
@@ -0,0 +1,23 @@
+/*! ----------------------------------------------------------------------------
+ *  @file    anchor_select.h
+ *  @brief   Choice of the anchors a tag ranges with, by geometric dilution of precision
+ *
+ *           From the tag's last position and the anchor table, picks the K anchors whose directions from the tag give the lowest horizontal
+ *           dilution of precision (HDOP), so that a fix needs fewer exchanges for the same accuracy when many anchors are in range.
+ */
+#ifndef __ANCHOR_SELECT_H__
+#define __ANCHOR_SELECT_H__
+
+#include <stdint.h>
+#include "trilateration.h"
+
+/* Anchors further than this from the last position, in metres, are not chosen (likely out of range). */
+#define ANCHOR_SEL_MAX_RANGE_M 30.0
+
+/* Closer than this to an anchor, in metres, its direction is undefined and it does not count in the HDOP. */
+#define ANCHOR_SEL_MIN_RANGE_M 0.1
+
+double anchor_hdop(const Anchor *tab, const uint8_t *idx, int k, const Position *pos);
+int anchor_select(const Anchor *tab, int n, uint32_t avail, const Position *pos, int k, uint8_t *sel);
+
+#endif
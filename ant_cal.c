@@ -0,0 +1,130 @@
+#include <math.h>
+#include <string.h>
+#include "ant_cal.h"
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn ant_cal_init()
+ *
+ * @brief Start a new calibration for n_dev devices (indexes 0 to n_dev - 1).
+ *
+ * @param  cal    calibration state
+ * @param  n_dev  number of devices, at most ANT_CAL_MAX_DEV
+ *
+ * @return none
+ */
+void ant_cal_init(ant_cal_t *cal, int n_dev)
+{
+    memset(cal, 0, sizeof(*cal));
+    cal->n_dev = (n_dev > ANT_CAL_MAX_DEV) ? ANT_CAL_MAX_DEV : n_dev;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn ant_cal_add()
+ *
+ * @brief Add one range sample between two devices. With the same delay used for TX and RX on a device, the SS TWR time of flight error is the
+ *        sum of the two devices' antenna delay errors, so each sample is one row "corr[a] + corr[b] = err" of the least squares problem.
+ *
+ * @param  cal      calibration state
+ * @param  dev_a    index of the first device
+ * @param  dev_b    index of the second device
+ * @param  err_dtu  measured minus true time of flight, in device time units
+ *
+ * @return none
+ */
+void ant_cal_add(ant_cal_t *cal, int dev_a, int dev_b, double err_dtu)
+{
+    if (dev_a < 0 || dev_b < 0 || dev_a >= cal->n_dev || dev_b >= cal->n_dev || dev_a == dev_b)
+        return;
+
+    cal->ata[dev_a][dev_a] += 1.0;
+    cal->ata[dev_b][dev_b] += 1.0;
+    cal->ata[dev_a][dev_b] += 1.0;
+    cal->ata[dev_b][dev_a] += 1.0;
+    cal->atb[dev_a] += err_dtu;
+    cal->atb[dev_b] += err_dtu;
+    cal->n_samples++;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn ant_cal_pin()
+ *
+ * @brief Mark a device whose antenna delay is already known (e.g. a reference unit): its correction is held at 0 with the given weight.
+ *
+ * @param  cal     calibration state
+ * @param  dev     device index
+ * @param  weight  weight of the constraint, in range samples
+ *
+ * @return none
+ */
+void ant_cal_pin(ant_cal_t *cal, int dev, double weight)
+{
+    if (dev >= 0 && dev < cal->n_dev)
+        cal->ata[dev][dev] += weight;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn ant_cal_solve()
+ *
+ * @brief Solve the normal equations for the antenna delay corrections. Add the correction to the delay currently programmed in each device
+ *        (applied to both TX and RX delays) to get its calibrated value.
+ *
+ * @param  cal       calibration state
+ * @param  corr_dtu  output, one correction per device, in device time units
+ *
+ * @return 0 on success, -1 if there are no samples or the system cannot be solved
+ */
+int ant_cal_solve(const ant_cal_t *cal, double *corr_dtu)
+{
+    double m[ANT_CAL_MAX_DEV][ANT_CAL_MAX_DEV + 1];
+    double ridge;
+    int n = cal->n_dev;
+    int i, j, k;
+
+    if (n < 2 || cal->n_samples == 0)
+        return -1;
+
+    ridge = ANT_CAL_RIDGE * (double)cal->n_samples / n;
+    for (i = 0; i < n; i++)
+    {
+        for (j = 0; j < n; j++)
+            m[i][j] = cal->ata[i][j];
+        m[i][i] += ridge;
+        m[i][n] = cal->atb[i];
+    }
+
+    /* Gaussian elimination with partial pivoting. */
+    for (k = 0; k < n; k++)
+    {
+        int piv = k;
+        for (i = k + 1; i < n; i++)
+        {
+            if (fabs(m[i][k]) > fabs(m[piv][k]))
+                piv = i;
+        }
+        if (fabs(m[piv][k]) < 1e-12)
+            return -1;
+        if (piv != k)
+        {
+            for (j = k; j <= n; j++)
+            {
+                double t = m[k][j];
+                m[k][j] = m[piv][j];
+                m[piv][j] = t;
+            }
+        }
+        for (i = k + 1; i < n; i++)
+        {
+            double f = m[i][k] / m[k][k];
+            for (j = k; j <= n; j++)
+                m[i][j] -= f * m[k][j];
+        }
+    }
+    for (i = n - 1; i >= 0; i--)
+    {
+        double s = m[i][n];
+        for (j = i + 1; j < n; j++)
+            s -= m[i][j] * corr_dtu[j];
+        corr_dtu[i] = s / m[i][i];
+    }
+    return 0;
+}
@@ -0,0 +1,42 @@
+/*! ----------------------------------------------------------------------------
+ *  @file    ant_cal.h
+ *  @brief   Antenna delay calibration
+ *
+ *           Least squares solver for per-device antenna delays from ranges measured between devices placed at known distances, plus storage of
+ *           the result in the DW IC OTP memory so it can be applied at start-up. The solver itself has no dependency on the DW IC driver.
+ */
+#ifndef __ANT_CAL_H__
+#define __ANT_CAL_H__
+
+#include <stdint.h>
+
+/* Maximum number of devices taking part in one calibration. */
+#define ANT_CAL_MAX_DEV 8
+
+/* Weight of the prior pulling every correction towards 0, relative to one range sample. It only matters when the pairs measured do not fix all
+ * devices (e.g. one tag against several anchors), in which case the error is shared between the devices of each pair. */
+#define ANT_CAL_RIDGE 1e-3
+
+/* OTP storage: two 32-bit words per record, ANT_CAL_OTP_SLOTS records starting at ANT_CAL_OTP_ADDR. OTP can only be written once, so every
+ * new calibration goes to the next free record and the last valid record wins at start-up. */
+#define ANT_CAL_OTP_ADDR  0x50
+#define ANT_CAL_OTP_SLOTS 4
+#define ANT_CAL_MAGIC     0xCA1Bu
+
+typedef struct
+{
+    int n_dev;                                   /* Number of devices in the calibration. */
+    uint32_t n_samples;                          /* Number of range samples added. */
+    double ata[ANT_CAL_MAX_DEV][ANT_CAL_MAX_DEV]; /* Normal equations, accumulated as samples come in. */
+    double atb[ANT_CAL_MAX_DEV];
+} ant_cal_t;
+
+void ant_cal_init(ant_cal_t *cal, int n_dev);
+void ant_cal_add(ant_cal_t *cal, int dev_a, int dev_b, double err_dtu);
+void ant_cal_pin(ant_cal_t *cal, int dev, double weight);
+int ant_cal_solve(const ant_cal_t *cal, double *corr_dtu);
+
+int ant_cal_load(uint16_t *tx_ant_dly, uint16_t *rx_ant_dly);
+int ant_cal_store(uint16_t tx_ant_dly, uint16_t rx_ant_dly);
+
+#endif
@@ -0,0 +1,72 @@
+#include <deca_device_api.h>
+#include "ant_cal.h"
+
+/* Second word of a record: magic in the high half, check value in the low half. */
+static uint32_t record_check(uint32_t delays)
+{
+    return ((uint32_t)ANT_CAL_MAGIC << 16) | ((delays ^ (delays >> 16) ^ 0xA5A5u) & 0xFFFFu);
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn ant_cal_load()
+ *
+ * @brief Read the last valid antenna delay record from OTP. Call after dwt_initialise() and apply the values with dwt_settxantennadelay() and
+ *        dwt_setrxantennadelay().
+ *
+ * @param  tx_ant_dly  output, calibrated TX antenna delay
+ * @param  rx_ant_dly  output, calibrated RX antenna delay
+ *
+ * @return 0 if a record was found, -1 if the device is not calibrated (outputs unchanged)
+ */
+int ant_cal_load(uint16_t *tx_ant_dly, uint16_t *rx_ant_dly)
+{
+    uint32_t rec[2];
+    int found = -1;
+    int slot;
+
+    for (slot = 0; slot < ANT_CAL_OTP_SLOTS; slot++)
+    {
+        dwt_otpread(ANT_CAL_OTP_ADDR + 2 * slot, rec, 2);
+        if (rec[0] == 0 && rec[1] == 0)
+            break;
+        if (rec[1] == record_check(rec[0]))
+        {
+            *tx_ant_dly = (uint16_t)(rec[0] >> 16);
+            *rx_ant_dly = (uint16_t)(rec[0] & 0xFFFF);
+            found = 0;
+        }
+    }
+    return found;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn ant_cal_store()
+ *
+ * @brief Write antenna delays to the next free OTP record. This cannot be undone and uses up one of the ANT_CAL_OTP_SLOTS records.
+ *
+ * @param  tx_ant_dly  TX antenna delay
+ * @param  rx_ant_dly  RX antenna delay
+ *
+ * @return 0 on success, -1 if all records are used or the OTP write failed
+ */
+int ant_cal_store(uint16_t tx_ant_dly, uint16_t rx_ant_dly)
+{
+    uint32_t rec[2];
+    uint32_t delays = ((uint32_t)tx_ant_dly << 16) | rx_ant_dly;
+    int slot;
+
+    for (slot = 0; slot < ANT_CAL_OTP_SLOTS; slot++)
+    {
+        uint16_t addr = (uint16_t)(ANT_CAL_OTP_ADDR + 2 * slot);
+
+        dwt_otpread(addr, rec, 2);
+        if (rec[0] != 0 || rec[1] != 0)
+            continue;
+        if (dwt_otpwriteandverify(delays, addr) != DWT_SUCCESS)
+            return -1;
+        if (dwt_otpwriteandverify(record_check(delays), (uint16_t)(addr + 1)) != DWT_SUCCESS)
+            return -1;
+        return 0;
+    }
+    return -1;
+}
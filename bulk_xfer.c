@@ -0,0 +1,191 @@
+#include <string.h>
+#include <deca_device_api.h>
+#include <port.h>
+#include <shared_functions.h>
+#include "bulk_xfer.h"
+
+/* Frame being sent, kept out of the stack. */
+static uint8_t bulk_frame[BULK_FRAME_MAX];
+static uint8_t bulk_id = 0;
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn bulk_tx_start()
+ *
+ * @brief Start a transfer to be sent chunk by chunk with bulk_tx_chunk(). Nothing is sent yet.
+ *
+ * @param  tx    transfer
+ * @param  dst   short address of the receiver
+ * @param  src   short address of the sender
+ * @param  type  BULK_TYPE_xxx
+ * @param  data  data to send, left untouched until the transfer is done
+ * @param  len   length of data, at most 65535 chunks
+ *
+ * @return none
+ */
+void bulk_tx_start(bulk_tx_t *tx, uint16_t dst, uint16_t src, uint8_t type, const uint8_t *data, uint32_t len)
+{
+    tx->data = data;
+    tx->len = len;
+    tx->ofs = 0;
+    tx->seq = 0;
+    tx->dst = dst;
+    tx->src = src;
+    tx->type = type;
+    tx->id = bulk_id++;
+    tx->active = 1;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn bulk_tx_chunk()
+ *
+ * @brief Send the next chunk of a transfer in one extended frame and wait for it to be sent. The PHY header is set to the extended mode for
+ *        the frame and back to the standard mode after it. Uses the start of the TX buffer: a response template kept there must be reloaded
+ *        afterwards. A receiver re-enabling RX by software needs BULK_CHUNK_GAP_MS between chunks.
+ *
+ * @param  tx  transfer
+ *
+ * @return 1 if chunks are left, 0 if the transfer is done, -1 if the TX could not be started (the transfer is abandoned)
+ */
+int bulk_tx_chunk(bulk_tx_t *tx)
+{
+    uint16_t n, flen;
+    int ret;
+
+    if (!tx->active)
+        return 0;
+
+    n = (tx->len - tx->ofs > BULK_CHUNK_MAX) ? BULK_CHUNK_MAX : (uint16_t)(tx->len - tx->ofs);
+    flen = BULK_HDR_LEN + n + 2;
+
+    bulk_frame[0] = 0x41; /* Data frame, 16-bit addressing. */
+    bulk_frame[1] = 0x88;
+    bulk_frame[2] = (uint8_t)tx->seq;
+    bulk_frame[3] = 0xCA; /* PAN ID 0xDECA. */
+    bulk_frame[4] = 0xDE;
+    bulk_frame[5] = (uint8_t)tx->dst;
+    bulk_frame[6] = (uint8_t)(tx->dst >> 8);
+    bulk_frame[7] = (uint8_t)tx->src;
+    bulk_frame[8] = (uint8_t)(tx->src >> 8);
+    bulk_frame[9] = BULK_FCODE;
+    bulk_frame[10] = tx->type;
+    bulk_frame[11] = tx->id;
+    bulk_frame[12] = (uint8_t)tx->seq;
+    bulk_frame[13] = (uint8_t)(tx->seq >> 8);
+    bulk_frame[14] = (tx->ofs + n >= tx->len) ? BULK_FLAG_LAST : 0;
+    memcpy(&bulk_frame[BULK_HDR_LEN], &tx->data[tx->ofs], n);
+
+    dwt_setphrmode(DWT_PHRMODE_EXT, DWT_PHRRATE_STD);
+    dwt_writetxdata(flen, bulk_frame, 0); /* Zero offset in TX buffer. */
+    dwt_writetxfctrl(flen, 0, 0);         /* Zero offset in TX buffer, no ranging. */
+    if (dwt_starttx(DWT_START_TX_IMMEDIATE) != DWT_SUCCESS)
+    {
+        ret = -1;
+        tx->active = 0;
+    }
+    else
+    {
+        waitforsysstatus(NULL, NULL, DWT_INT_TXFRS_BIT_MASK, 0);
+        dwt_writesysstatuslo(DWT_INT_TXFRS_BIT_MASK);
+        tx->ofs += n;
+        tx->seq++;
+        tx->active = (tx->ofs < tx->len);
+        ret = tx->active;
+    }
+    dwt_setphrmode(DWT_PHRMODE_STD, DWT_PHRRATE_STD);
+
+    return ret;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn bulk_send()
+ *
+ * @brief Send a block of data as a sequence of extended frames, waiting for each to be sent and BULK_CHUNK_GAP_MS between them. Blocks the
+ *        caller for the whole transfer; a device that must keep answering uses bulk_tx_start() and bulk_tx_chunk() instead.
+ *
+ * @param  dst   short address of the receiver
+ * @param  src   short address of the sender
+ * @param  type  BULK_TYPE_xxx
+ * @param  data  data to send
+ * @param  len   length of data, at most 65535 chunks
+ *
+ * @return number of frames sent, -1 if a TX could not be started
+ */
+int bulk_send(uint16_t dst, uint16_t src, uint8_t type, const uint8_t *data, uint32_t len)
+{
+    bulk_tx_t tx;
+    int ret = 0, more;
+
+    bulk_tx_start(&tx, dst, src, type, data, len);
+    do
+    {
+        if (ret > 0)
+            Sleep(BULK_CHUNK_GAP_MS);
+        more = bulk_tx_chunk(&tx);
+        if (more < 0)
+            return -1;
+        ret++;
+    } while (more);
+
+    return ret;
+}
+
+void bulk_rx_init(bulk_rx_t *rx)
+{
+    rx->len = 0;
+    rx->next = 0;
+    rx->active = 0;
+    rx->done = 0;
+    rx->lost = 0;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn bulk_rx_frame()
+ *
+ * @brief Receiver side: add a received frame to the transfer in progress. A chunk 0 starts a new transfer (dropping an unfinished one); a
+ *        chunk out of sequence, from another transfer, or overflowing BULK_RX_MAX drops the transfer.
+ *
+ * @param  rx     reassembly state
+ * @param  frame  received frame
+ * @param  len    frame length including the checksum
+ *
+ * @return 1 when a transfer is complete (rx->type, rx->buf, rx->len), 0 for a chunk taken or dropped, -1 if the frame is not a bulk frame
+ */
+int bulk_rx_frame(bulk_rx_t *rx, const uint8_t *frame, uint16_t len)
+{
+    uint16_t seq, n;
+
+    if (len < BULK_HDR_LEN + 2 || frame[0] != 0x41 || frame[9] != BULK_FCODE)
+        return -1;
+    seq = frame[12] | (frame[13] << 8);
+    n = len - BULK_HDR_LEN - 2;
+
+    if (seq == 0)
+    {
+        if (rx->active)
+            rx->lost++;
+        rx->active = 1;
+        rx->type = frame[10];
+        rx->id = frame[11];
+        rx->len = 0;
+        rx->next = 0;
+    }
+    if (!rx->active)
+        return 0;
+    if (seq != rx->next || frame[11] != rx->id || rx->len + n > BULK_RX_MAX)
+    {
+        rx->active = 0;
+        rx->lost++;
+        return 0;
+    }
+
+    memcpy(&rx->buf[rx->len], &frame[BULK_HDR_LEN], n);
+    rx->len += n;
+    rx->next++;
+    if (frame[14] & BULK_FLAG_LAST)
+    {
+        rx->active = 0;
+        rx->done++;
+        return 1;
+    }
+    return 0;
+}
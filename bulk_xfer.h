@@ -0,0 +1,67 @@
+/*! ----------------------------------------------------------------------------
+ *  @file    bulk_xfer.h
+ *  @brief   Bulk data transfer in extended length (DWT_PHRMODE_EXT) frames
+ *
+ *           A block of data (a batch of position reports, a diagnostics dump) is cut into chunks of up to BULK_CHUNK_MAX bytes, each sent in
+ *           one frame of up to 1023 bytes with function code BULK_FCODE. The sender switches its PHY header to the extended mode for the
+ *           transfer only, so its ranging frames are unchanged; the receiver stays in the extended mode, which also receives standard frames.
+ *
+ *           Frame: the 10 byte header common to all frames of the examples, then:
+ *             - byte 10: data type, BULK_TYPE_xxx.
+ *             - byte 11: transfer number, incremented for each transfer.
+ *             - byte 12/13: chunk sequence number in the transfer, from 0, little endian.
+ *             - byte 14: flags, BULK_FLAG_LAST on the last chunk.
+ *           the chunk data and the 2 byte checksum.
+ */
+#ifndef __BULK_XFER_H__
+#define __BULK_XFER_H__
+
+#include <stdint.h>
+
+#define BULK_FCODE 0xE3
+
+/* Largest extended frame, checksum included, header length and chunk data per frame. */
+#define BULK_FRAME_MAX 1023
+#define BULK_HDR_LEN   15
+#define BULK_CHUNK_MAX (BULK_FRAME_MAX - BULK_HDR_LEN - 2)
+
+/* Largest transfer the receiver reassembles, in bytes. */
+#define BULK_RX_MAX 2048
+
+/* Pause between chunks, in milliseconds, for a receiver that re-enables RX by software between frames. */
+#define BULK_CHUNK_GAP_MS 5
+
+#define BULK_TYPE_REPORT 1 /* Aggregated position report, see report_agg.h. */
+#define BULK_TYPE_DIAG   2 /* Diagnostics dump. */
+
+#define BULK_FLAG_LAST 0x01
+
+/* Transfer sent one chunk at a time, for a caller that sends in its idle time. */
+typedef struct
+{
+    const uint8_t *data; /* Data of the transfer, kept by the caller until it is done. */
+    uint32_t len, ofs;   /* Length, and bytes sent. */
+    uint16_t seq;        /* Next chunk sequence number. */
+    uint16_t dst, src;
+    uint8_t type, id;
+    uint8_t active;      /* Chunks left to send. */
+} bulk_tx_t;
+
+typedef struct
+{
+    uint8_t buf[BULK_RX_MAX]; /* Data of the transfer in progress, or of the last completed one. */
+    uint32_t len;             /* Bytes in buf. */
+    uint16_t next;            /* Next chunk sequence number expected. */
+    uint8_t type;             /* BULK_TYPE_xxx of the transfer. */
+    uint8_t id;               /* Transfer number. */
+    uint8_t active;           /* Transfer in progress. */
+    uint32_t done, lost;      /* Transfers completed and dropped (missing chunk or too long). */
+} bulk_rx_t;
+
+int bulk_send(uint16_t dst, uint16_t src, uint8_t type, const uint8_t *data, uint32_t len);
+void bulk_tx_start(bulk_tx_t *tx, uint16_t dst, uint16_t src, uint8_t type, const uint8_t *data, uint32_t len);
+int bulk_tx_chunk(bulk_tx_t *tx);
+void bulk_rx_init(bulk_rx_t *rx);
+int bulk_rx_frame(bulk_rx_t *rx, const uint8_t *frame, uint16_t len);
+
+#endif
@@ -0,0 +1,101 @@
+#include <math.h>
+#include <string.h>
+#include "clock_track.h"
+
+/* 40-bit device time mask and minimum local interval (1 ms in device time units) for a usable time-stamp pair. See NOTE 14 in ss_twr_initiator.c. */
+#define TS_40BIT_MASK 0xFFFFFFFFFFULL
+#define CLK_TRACK_MIN_TS_INTERVAL 63897600ULL
+
+static clk_peer_t peers[CLK_TRACK_MAX_PEERS];
+
+void clk_track_init(void)
+{
+    memset(peers, 0, sizeof(peers));
+}
+
+static clk_peer_t *find_peer(uint16_t addr)
+{
+    int i;
+    clk_peer_t *oldest = &peers[0];
+
+    for (i = 0; i < CLK_TRACK_MAX_PEERS; i++)
+    {
+        if (peers[i].used && peers[i].addr == addr)
+            return &peers[i];
+    }
+    for (i = 0; i < CLK_TRACK_MAX_PEERS; i++)
+    {
+        if (!peers[i].used)
+        {
+            oldest = &peers[i];
+            break;
+        }
+        if (peers[i].count < oldest->count)
+            oldest = &peers[i];
+    }
+    /* Table full: recycle the least used entry. */
+    memset(oldest, 0, sizeof(*oldest));
+    oldest->used = 1;
+    oldest->addr = addr;
+    return oldest;
+}
+
+/* Blend a new reading into the estimate, rejecting it if it is too far from the current value. */
+static void apply(clk_peer_t *p, float reading, float alpha)
+{
+    if (fabsf(reading - p->ratio) > CLK_TRACK_GATE)
+    {
+        if (++p->rejects < CLK_TRACK_MAX_REJECT)
+            return;
+        /* Persistent disagreement, the peer clock moved: start over from this reading. */
+        p->ratio = reading;
+        p->rejects = 0;
+        p->count = 1;
+        return;
+    }
+    p->rejects = 0;
+    p->ratio += alpha * (reading - p->ratio);
+    if (p->count < 0xFFFF)
+        p->count++;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn clk_track_update()
+ *
+ * @brief Feed the readings of one successful exchange and return the smoothed clock offset ratio to use for its ToF.
+ *
+ * @param  addr       short address of the responder
+ * @param  ci_ratio   carrier integrator ratio of the response, dwt_readclockoffset() / 2^26
+ * @param  poll_tx_ts local 40-bit poll TX time-stamp
+ * @param  poll_rx_ts remote 32-bit poll RX time-stamp carried in the response
+ *
+ * @return smoothed clock offset ratio
+ */
+float clk_track_update(uint16_t addr, float ci_ratio, uint64_t poll_tx_ts, uint32_t poll_rx_ts)
+{
+    clk_peer_t *p = find_peer(addr);
+
+    if (p->count == 0)
+    {
+        p->ratio = ci_ratio;
+        p->count = 1;
+    }
+    else
+    {
+        uint64_t local = (poll_tx_ts - p->last_poll_tx) & TS_40BIT_MASK;
+
+        apply(p, ci_ratio, CLK_TRACK_CI_ALPHA);
+
+        /* The remote time-stamp is only 32 bits, so the pair is unambiguous only while the exchanges are less than ~67 ms apart. */
+        if (local >= CLK_TRACK_MIN_TS_INTERVAL && local < 0x100000000ULL)
+        {
+            uint32_t remote = poll_rx_ts - p->last_poll_rx;
+
+            apply(p, (float)(((double)remote - (double)local) / (double)remote), CLK_TRACK_TS_ALPHA);
+        }
+    }
+
+    p->last_poll_tx = poll_tx_ts;
+    p->last_poll_rx = poll_rx_ts;
+    return p->ratio;
+}
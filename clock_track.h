@@ -0,0 +1,39 @@
+/*! ----------------------------------------------------------------------------
+ *  @file    clock_track.h
+ *  @brief   Per-peer clock offset tracking for SS TWR
+ *
+ *           Keeps a smoothed clock offset ratio for every responder the initiator ranges with. The ratio is fed from the carrier integrator
+ *           (dwt_readclockoffset()) and from the drift seen between the local poll TX and the remote poll RX time-stamps of consecutive exchanges.
+ */
+#ifndef __CLOCK_TRACK_H__
+#define __CLOCK_TRACK_H__
+
+#include <stdint.h>
+
+/* Number of responders that can be tracked at the same time. */
+#define CLK_TRACK_MAX_PEERS 8
+
+/* Weight of a new carrier integrator reading and of a new time-stamp pair estimate in the smoothed ratio. */
+#define CLK_TRACK_CI_ALPHA 0.125f
+#define CLK_TRACK_TS_ALPHA 0.25f
+
+/* Readings further than this from the current estimate are rejected as outliers (ratio, 5 ppm). */
+#define CLK_TRACK_GATE 5e-6f
+/* After this many consecutive rejected readings the estimate is re-seeded, e.g. after a responder reset. */
+#define CLK_TRACK_MAX_REJECT 4
+
+typedef struct
+{
+    uint16_t addr;         /* Peer short address. */
+    uint8_t used;          /* Slot in use. */
+    uint8_t rejects;       /* Consecutive rejected readings. */
+    uint16_t count;        /* Number of readings accepted so far. */
+    float ratio;           /* Smoothed clock offset ratio, same convention as dwt_readclockoffset() / 2^26. */
+    uint64_t last_poll_tx; /* Local 40-bit poll TX time-stamp of the previous exchange. */
+    uint32_t last_poll_rx; /* Remote 32-bit poll RX time-stamp of the previous exchange. */
+} clk_peer_t;
+
+void clk_track_init(void);
+float clk_track_update(uint16_t addr, float ci_ratio, uint64_t poll_tx_ts, uint32_t poll_rx_ts);
+
+#endif
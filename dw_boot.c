@@ -0,0 +1,150 @@
+#include "deca_probe_interface.h"
+#include <deca_device_api.h>
+#include <port.h>
+#include "dw_boot.h"
+
+/* FNV-1a hash of the configuration, so that a changed configuration forces a cold start. */
+static uint32_t config_sig(const dwt_config_t *cfg, uint32_t app_sig)
+{
+    const uint8_t *p = (const uint8_t *)cfg;
+    uint32_t h = 2166136261UL ^ app_sig;
+    uint16_t i;
+
+    for (i = 0; i < sizeof(*cfg); i++)
+    {
+        h ^= p[i];
+        h *= 16777619UL;
+    }
+    return h;
+}
+
+/* The DW IC kept our configuration: the signature is in its scratch RAM and the PLL is running (the system time only counts in IDLE_PLL). */
+static int is_warm(uint32_t sig)
+{
+    uint8_t rec[8];
+    uint32_t magic, stored, t0;
+
+    dwt_read_rx_scratch_data(rec, sizeof(rec), DW_BOOT_SCRATCH_OFS);
+    magic = rec[0] | ((uint32_t)rec[1] << 8) | ((uint32_t)rec[2] << 16) | ((uint32_t)rec[3] << 24);
+    stored = rec[4] | ((uint32_t)rec[5] << 8) | ((uint32_t)rec[6] << 16) | ((uint32_t)rec[7] << 24);
+    if (magic != DW_BOOT_MAGIC || stored != sig)
+        return 0;
+
+    t0 = dwt_readsystimestamphi32();
+    return dwt_readsystimestamphi32() != t0;
+}
+
+static void write_sig(uint32_t sig)
+{
+    uint8_t rec[8];
+    int i;
+
+    for (i = 0; i < 4; i++)
+    {
+        rec[i] = (uint8_t)(DW_BOOT_MAGIC >> (8 * i));
+        rec[4 + i] = (uint8_t)(sig >> (8 * i));
+    }
+    dwt_write_rx_scratch_data(rec, sizeof(rec), DW_BOOT_SCRATCH_OFS);
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dw_boot()
+ *
+ * @brief Bring the DW IC up, replacing the reset / dwt_probe() / dwt_initialise() / dwt_configure() sequence of the examples.
+ *
+ *        Warm path: dwt_probe() binds the driver, the signature and the running system time are checked, dwt_initialise() rebuilds the driver
+ *        state (OTP values only, the DW IC is not reset), any TX/RX left by the previous run is stopped and app_config() is applied. The
+ *        calibration results of the previous cold start are still in the DW IC registers and are used as they are.
+ *
+ *        Cold path: the usual reset, dwt_initialise(), dwt_configure() with its PLL and RX calibrations, app_config(), then the signature is
+ *        written.
+ *
+ *        The warm path relies on the driver state set by dwt_configure() being the same as after dwt_initialise(), which holds for standard PHR
+ *        mode with STS off (as in these examples). With other configurations call dw_boot_invalidate() before each reset or use the cold path.
+ *
+ * @param  probe       probe interface, normally &dw3000_probe_interf
+ * @param  cfg         configuration for dwt_configure()
+ * @param  app_config  settings applied after dwt_configure() (TX spectrum, antenna delays, addresses...), on both paths
+ * @param  app_sig     application value mixed into the signature, e.g. a version of app_config()
+ * @param  t           output, step timing
+ *
+ * @return DWT_SUCCESS, or DWT_ERROR if dwt_initialise() or dwt_configure() failed
+ */
+int dw_boot(const struct dwt_probe_s *probe, dwt_config_t *cfg, void (*app_config)(void), uint32_t app_sig, dw_boot_times_t *t)
+{
+    uint32_t sig = config_sig(cfg, app_sig);
+    uint32_t start = DW_BOOT_TICK(), mark;
+
+    t->warm = 0;
+    t->reset = t->probe = t->init = t->config = t->app = 0;
+
+    /* Warm path. */
+    mark = DW_BOOT_TICK();
+    if (dwt_probe((struct dwt_probe_s *)probe) == DWT_SUCCESS && is_warm(sig))
+    {
+        t->probe = DW_BOOT_TICK() - mark;
+
+        mark = DW_BOOT_TICK();
+        if (dwt_initialise(DWT_DW_INIT) == DWT_ERROR)
+            return DWT_ERROR;
+        dwt_forcetrxoff();
+        dwt_writesysstatuslo(0xFFFFFFFFUL);
+        t->init = DW_BOOT_TICK() - mark;
+
+        mark = DW_BOOT_TICK();
+        app_config();
+        t->app = DW_BOOT_TICK() - mark;
+
+        t->warm = 1;
+        t->total = DW_BOOT_TICK() - start;
+        return DWT_SUCCESS;
+    }
+
+    /* Cold path. */
+    mark = DW_BOOT_TICK();
+    reset_DWIC(); /* Target specific drive of RSTn line into DW3000 low for a period. */
+    Sleep(2);     /* Time needed for DW3000 to start up (transition from INIT_RC to IDLE_RC, or could wait for SPIRDY event) */
+    t->reset = DW_BOOT_TICK() - mark;
+
+    mark = DW_BOOT_TICK();
+    dwt_probe((struct dwt_probe_s *)probe);
+    while (!dwt_checkidlerc()) /* Need to make sure DW IC is in IDLE_RC before proceeding */ { };
+    t->probe = DW_BOOT_TICK() - mark;
+
+    mark = DW_BOOT_TICK();
+    if (dwt_initialise(DWT_DW_INIT) == DWT_ERROR)
+        return DWT_ERROR;
+    t->init = DW_BOOT_TICK() - mark;
+
+    /* Enabling LEDs here for debug so that for each TX the D1 LED will flash on DW3000 red eval-shield boards. */
+    dwt_setleds(DWT_LEDS_ENABLE | DWT_LEDS_INIT_BLINK);
+
+    mark = DW_BOOT_TICK();
+    if (dwt_configure(cfg))
+        return DWT_ERROR;
+    t->config = DW_BOOT_TICK() - mark;
+
+    mark = DW_BOOT_TICK();
+    app_config();
+    t->app = DW_BOOT_TICK() - mark;
+
+    write_sig(sig);
+    t->total = DW_BOOT_TICK() - start;
+    return DWT_SUCCESS;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dw_boot_invalidate()
+ *
+ * @brief Clear the signature so that the next dw_boot() takes the cold path.
+ *
+ * @param  none
+ *
+ * @return none
+ */
+void dw_boot_invalidate(void)
+{
+    uint8_t rec[8] = { 0 };
+
+    dwt_write_rx_scratch_data(rec, sizeof(rec), DW_BOOT_SCRATCH_OFS);
+}
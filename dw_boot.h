@@ -0,0 +1,40 @@
+/*! ----------------------------------------------------------------------------
+ *  @file    dw_boot.h
+ *  @brief   DW IC start-up with a warm restart path
+ *
+ *           After an MCU reset (e.g. watchdog) the DW IC is usually still powered, running and configured. A signature of the configuration is
+ *           kept in the DW IC scratch RAM; when it matches and the system time is running, the reset, the PLL/RX calibrations and dwt_configure()
+ *           are skipped and only the driver state and the application settings are restored. Every step is timed.
+ */
+#ifndef __DW_BOOT_H__
+#define __DW_BOOT_H__
+
+#include <stdint.h>
+#include <deca_device_api.h>
+#include "deca_probe_interface.h"
+
+/* Tick used for the step timing. portGetTickCnt() counts milliseconds; a board with a microsecond timer can override both. */
+#ifndef DW_BOOT_TICK
+#define DW_BOOT_TICK()    portGetTickCnt()
+#define DW_BOOT_TICK_UNIT "ms"
+#endif
+
+/* Signature record in the DW IC scratch RAM. */
+#define DW_BOOT_MAGIC       0x314D5257UL /* "WRM1" */
+#define DW_BOOT_SCRATCH_OFS 0
+
+typedef struct
+{
+    uint8_t warm;      /* 1 if the warm path was taken. */
+    uint32_t reset;    /* Ticks spent in each step. */
+    uint32_t probe;
+    uint32_t init;
+    uint32_t config;
+    uint32_t app;
+    uint32_t total;
+} dw_boot_times_t;
+
+int dw_boot(const struct dwt_probe_s *probe, dwt_config_t *cfg, void (*app_config)(void), uint32_t app_sig, dw_boot_times_t *t);
+void dw_boot_invalidate(void);
+
+#endif
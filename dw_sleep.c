@@ -0,0 +1,75 @@
+#include <deca_device_api.h>
+#include <port.h>
+#include "dw_sleep.h"
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dw_sleep_init()
+ *
+ * @brief Configure the sleep mode once, after dwt_configure(): keep the configuration and the PGF calibration across DEEPSLEEP and wake up on
+ *        the SPI chip select.
+ *
+ * @param  none
+ *
+ * @return none
+ */
+void dw_sleep_init(void)
+{
+    dwt_configuresleep(DWT_CONFIG | DWT_PGFCAL, DWT_PRES_SLEEP | DWT_WAKE_CSN | DWT_SLP_EN);
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dw_sleep_enter()
+ *
+ * @brief Put the DW IC into DEEPSLEEP. It must be idle (no TX or RX pending).
+ *
+ * @param  none
+ *
+ * @return none
+ */
+void dw_sleep_enter(void)
+{
+    dwt_entersleep(DWT_DW_IDLE);
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dw_sleep_wake()
+ *
+ * @brief Wake the DW IC and restore its configuration from the AON block. Settings the AON block does not hold (see the caller) have to be
+ *        written again afterwards. Starts the wake-up to first poll measurement.
+ *
+ * @param  st  wake-up statistics
+ *
+ * @return none
+ */
+void dw_sleep_wake(dw_wake_stats_t *st)
+{
+    st->wake_tick = portGetTickCnt();
+    st->pending = 1;
+
+    port_wakeup_dw3000();
+    while (!dwt_checkidlerc()) { };
+    dwt_restoreconfig();
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dw_sleep_first_poll()
+ *
+ * @brief Call when a poll has been sent: ends the measurement started by the last dw_sleep_wake(), if any.
+ *
+ * @param  st  wake-up statistics
+ *
+ * @return none
+ */
+void dw_sleep_first_poll(dw_wake_stats_t *st)
+{
+    uint32_t ms;
+
+    if (!st->pending)
+        return;
+    st->pending = 0;
+    ms = portGetTickCnt() - st->wake_tick;
+    st->wakes++;
+    st->sum_ms += ms;
+    if (ms > st->max_ms)
+        st->max_ms = ms;
+}
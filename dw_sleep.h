@@ -0,0 +1,30 @@
+/*! ----------------------------------------------------------------------------
+ *  @file    dw_sleep.h
+ *  @brief   DW IC deep sleep between ranging exchanges
+ *
+ *           Puts the DW IC into DEEPSLEEP with its configuration kept in the AON block, wakes it with the SPI chip select and restores the
+ *           configuration without dwt_initialise()/dwt_configure(). The time from the wake-up to the first poll is measured.
+ */
+#ifndef __DW_SLEEP_H__
+#define __DW_SLEEP_H__
+
+#include <stdint.h>
+
+/* Sleeping is not worth the wake-up below this idle time, in milliseconds. */
+#define DW_SLEEP_MIN_MS 10
+
+typedef struct
+{
+    uint32_t wakes;       /* Number of wake-ups measured. */
+    uint32_t sum_ms;      /* Sum of the wake-up to first poll times. */
+    uint32_t max_ms;      /* Longest wake-up to first poll time. */
+    uint32_t wake_tick;   /* Tick of the pending wake-up. */
+    uint8_t pending;      /* Woken up, first poll not sent yet. */
+} dw_wake_stats_t;
+
+void dw_sleep_init(void);
+void dw_sleep_enter(void);
+void dw_sleep_wake(dw_wake_stats_t *st);
+void dw_sleep_first_poll(dw_wake_stats_t *st);
+
+#endif
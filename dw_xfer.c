@@ -0,0 +1,111 @@
+#include <deca_device_api.h>
+#include "dw_xfer.h"
+
+struct dwt_probe_s dw_xfer_probe_interf;
+volatile dw_xfer_stats_t dw_xfer_stats;
+
+/* SPI functions of the board, called for the actual transfers. */
+static struct dwt_spi_s board_spi;
+static struct dwt_spi_s xfer_spi;
+
+static int xfer_read(uint16_t headerLength, uint8_t *headerBuffer, uint16_t readLength, uint8_t *readBuffer)
+{
+    dw_xfer_stats.reads++;
+    dw_xfer_stats.bytes += headerLength + readLength;
+#ifdef DW_XFER_DMA
+    if (readLength >= DW_XFER_DMA_MIN)
+    {
+        dw_xfer_stats.dma++;
+        return port_spi_dma_read(headerLength, headerBuffer, readLength, readBuffer);
+    }
+#endif
+    return board_spi.readfromspi(headerLength, headerBuffer, readLength, readBuffer);
+}
+
+static int xfer_write(uint16_t headerLength, const uint8_t *headerBuffer, uint16_t bodyLength, const uint8_t *bodyBuffer)
+{
+    dw_xfer_stats.writes++;
+    dw_xfer_stats.bytes += headerLength + bodyLength;
+#ifdef DW_XFER_DMA
+    if (bodyLength >= DW_XFER_DMA_MIN)
+    {
+        dw_xfer_stats.dma++;
+        return port_spi_dma_write(headerLength, headerBuffer, bodyLength, bodyBuffer);
+    }
+#endif
+    return board_spi.writetospi(headerLength, headerBuffer, bodyLength, bodyBuffer);
+}
+
+static int xfer_write_crc(uint16_t headerLength, const uint8_t *headerBuffer, uint16_t bodyLength, const uint8_t *bodyBuffer, uint8_t crc8)
+{
+    dw_xfer_stats.writes++;
+    dw_xfer_stats.bytes += headerLength + bodyLength + 1;
+    return board_spi.writetospiwithcrc(headerLength, headerBuffer, bodyLength, bodyBuffer, crc8);
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dw_xfer_init()
+ *
+ * @brief Build dw_xfer_probe_interf from the board's dw3000_probe_interf, with the SPI functions wrapped. Call before dwt_probe().
+ *
+ * @param  none
+ *
+ * @return none
+ */
+void dw_xfer_init(void)
+{
+    board_spi = *(const struct dwt_spi_s *)dw3000_probe_interf.spi;
+    xfer_spi = board_spi;
+    xfer_spi.readfromspi = xfer_read;
+    xfer_spi.writetospi = xfer_write;
+    xfer_spi.writetospiwithcrc = xfer_write_crc;
+
+    dw_xfer_probe_interf = dw3000_probe_interf;
+    dw_xfer_probe_interf.spi = &xfer_spi;
+
+    dw_xfer_stats.reads = dw_xfer_stats.writes = dw_xfer_stats.bytes = dw_xfer_stats.dma = 0;
+}
+
+void dw_xfer_bench_reset(dw_xfer_bench_t *b)
+{
+    b->n = b->late = b->txn = b->bytes = b->ta_sum = b->ta_max = 0;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dw_xfer_bench_start()
+ *
+ * @brief Start measuring an exchange, as soon as the poll is seen received.
+ *
+ * @param  b  benchmark
+ *
+ * @return none
+ */
+void dw_xfer_bench_start(dw_xfer_bench_t *b)
+{
+    b->txn0 = dw_xfer_stats.reads + dw_xfer_stats.writes;
+    b->bytes0 = dw_xfer_stats.bytes;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dw_xfer_bench_tx()
+ *
+ * @brief End the measurement just before the delayed TX is started: count the SPI traffic since dw_xfer_bench_start() and the time since the
+ *        poll was received (one more system time read, not counted).
+ *
+ * @param  b            benchmark
+ * @param  poll_rx_ts   poll RX time-stamp
+ *
+ * @return none
+ */
+void dw_xfer_bench_tx(dw_xfer_bench_t *b, uint64_t poll_rx_ts)
+{
+    uint32_t ta;
+
+    b->txn += dw_xfer_stats.reads + dw_xfer_stats.writes - b->txn0;
+    b->bytes += dw_xfer_stats.bytes - b->bytes0;
+    ta = dwt_readsystimestamphi32() - (uint32_t)(poll_rx_ts >> 8);
+    b->ta_sum += ta;
+    if (ta > b->ta_max)
+        b->ta_max = ta;
+    b->n++;
+}
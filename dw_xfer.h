@@ -0,0 +1,57 @@
+/*! ----------------------------------------------------------------------------
+ *  @file    dw_xfer.h
+ *  @brief   SPI transport for the DW IC driver with transaction counting and optional DMA
+ *
+ *           Wraps the SPI functions of the probe interface: every transaction and byte is counted so the SPI cost of an exchange can be
+ *           measured, and, with DW_XFER_DMA defined, transfers of DW_XFER_DMA_MIN bytes or more go through the board's SPI DMA functions.
+ */
+#ifndef __DW_XFER_H__
+#define __DW_XFER_H__
+
+#include <stdint.h>
+#include "deca_probe_interface.h"
+
+/* Transfers with a body of at least this many bytes use DMA when DW_XFER_DMA is defined. Below it, setting up the DMA costs more than it saves. */
+#define DW_XFER_DMA_MIN 16
+
+#ifdef DW_XFER_DMA
+/* Board SPI DMA transfers, same arguments and return value as readfromspi()/writetospi(). They return when the transfer is complete. */
+int port_spi_dma_read(uint16_t headerLength, uint8_t *headerBuffer, uint16_t readLength, uint8_t *readBuffer);
+int port_spi_dma_write(uint16_t headerLength, const uint8_t *headerBuffer, uint16_t bodyLength, const uint8_t *bodyBuffer);
+#endif
+
+typedef struct
+{
+    uint32_t reads;  /* SPI read transactions. */
+    uint32_t writes; /* SPI write transactions. */
+    uint32_t bytes;  /* Bytes transferred, headers included. */
+    uint32_t dma;    /* Transactions done by DMA. */
+} dw_xfer_stats_t;
+
+/* Per-exchange benchmark: SPI transactions and bytes from poll RX to the delayed TX start, and the time that took (turnaround). */
+typedef struct
+{
+    uint32_t n;       /* Exchanges measured. */
+    uint32_t late;    /* Delayed TX started too late. */
+    uint32_t txn;     /* Sum of SPI transactions. */
+    uint32_t bytes;   /* Sum of SPI bytes. */
+    uint32_t ta_sum;  /* Sum of turnarounds, in system time high 32 bit ticks (1 / 249.6 MHz, ~4 ns). */
+    uint32_t ta_max;  /* Longest turnaround. */
+    uint32_t txn0;    /* Counters at the start of the current exchange. */
+    uint32_t bytes0;
+} dw_xfer_bench_t;
+
+/* System time high 32 bit ticks per microsecond. */
+#define DW_XFER_TICKS_PER_US 249.6
+
+/* Probe interface to pass to dwt_probe() instead of dw3000_probe_interf, valid after dw_xfer_init(). */
+extern struct dwt_probe_s dw_xfer_probe_interf;
+/* Running counters. */
+extern volatile dw_xfer_stats_t dw_xfer_stats;
+
+void dw_xfer_init(void);
+void dw_xfer_bench_reset(dw_xfer_bench_t *b);
+void dw_xfer_bench_start(dw_xfer_bench_t *b);
+void dw_xfer_bench_tx(dw_xfer_bench_t *b, uint64_t poll_rx_ts);
+
+#endif
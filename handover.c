@@ -0,0 +1,187 @@
+#include <math.h>
+#include <deca_device_api.h>
+#include <port.h>
+#include <shared_functions.h>
+#include "zone.h"
+#include "handover.h"
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn ho_beacon_build()
+ *
+ * @brief Fill a beacon frame, HO_BEACON_LEN bytes.
+ *
+ * @param  frame  output, the frame
+ * @param  sn     sequence number
+ * @param  src    anchor short address
+ * @param  zone   anchor's zone
+ * @param  tags   number of tags the anchor serves
+ *
+ * @return none
+ */
+void ho_beacon_build(uint8_t *frame, uint8_t sn, uint16_t src, uint8_t zone, uint8_t tags)
+{
+    frame[0] = 0x41; /* Data frame, 16-bit addressing. */
+    frame[1] = 0x88;
+    frame[2] = sn;
+    frame[3] = 0xCA; /* PAN ID 0xDECA. */
+    frame[4] = 0xDE;
+    frame[5] = 0xFF; /* Broadcast. */
+    frame[6] = 0xFF;
+    frame[7] = (uint8_t)src;
+    frame[8] = (uint8_t)(src >> 8);
+    frame[9] = HO_BEACON_FCODE;
+    frame[10] = zone;
+    frame[11] = tags;
+}
+
+void ho_init(ho_t *ho)
+{
+    ho->link = 1.0f;
+    ho->last_scan_ms = portGetTickCnt();
+    ho->next = 0;
+    ho->scans = 0;
+    ho->handovers = 0;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn ho_link()
+ *
+ * @brief Update the link quality after a fix.
+ *
+ * @param  ho         handover state
+ * @param  answered   anchors of the fix that answered
+ * @param  scheduled  anchors ranged for the fix
+ *
+ * @return none
+ */
+void ho_link(ho_t *ho, int answered, int scheduled)
+{
+    float q = (scheduled > 0) ? (float)answered / scheduled : 0.0f;
+
+    ho->link += HO_LINK_ALPHA * (q - ho->link);
+}
+
+/* Mean horizontal distance from pos to the HO_MIN_ANCHORS nearest anchors of a zone, -1 if the zone has fewer. */
+static double ho_zone_dist(const Anchor *tab, const uint8_t *zone_of, int n, const Position *pos, uint8_t zone)
+{
+    double near[HO_MIN_ANCHORS], d, sum = 0.0;
+    int i, j, k = 0;
+
+    for (i = 0; i < n; i++)
+    {
+        if (zone_of[i] != zone)
+            continue;
+        d = sqrt((tab[i].x - pos->x) * (tab[i].x - pos->x) + (tab[i].y - pos->y) * (tab[i].y - pos->y));
+        /* Insert among the nearest so far, kept sorted; when full the farthest drops out. */
+        if (k < HO_MIN_ANCHORS)
+            k++;
+        else if (d >= near[k - 1])
+            continue;
+        for (j = k - 1; j > 0 && near[j - 1] > d; j--)
+            near[j] = near[j - 1];
+        near[j] = d;
+    }
+    if (k < HO_MIN_ANCHORS)
+        return -1.0;
+    for (i = 0; i < HO_MIN_ANCHORS; i++)
+        sum += near[i];
+    return sum / HO_MIN_ANCHORS;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn ho_candidate()
+ *
+ * @brief Zone the tag should move to from its position: the zone whose HO_MIN_ANCHORS nearest anchors are nearest on average, if it beats the
+ *        current zone by HO_HYST_M.
+ *
+ * @param  tab      anchor table
+ * @param  zone_of  zone of each anchor
+ * @param  n        number of anchors
+ * @param  pos      tag position
+ * @param  cur      current zone
+ *
+ * @return zone number, -1 if the tag should stay
+ */
+int ho_candidate(const Anchor *tab, const uint8_t *zone_of, int n, const Position *pos, uint8_t cur)
+{
+    double cur_d = ho_zone_dist(tab, zone_of, n, pos, cur), best_d = -1.0, d;
+    int z, best = -1;
+
+    for (z = 0; z < ZONE_NUM; z++)
+    {
+        if (z == cur)
+            continue;
+        d = ho_zone_dist(tab, zone_of, n, pos, (uint8_t)z);
+        if (d >= 0.0 && (best < 0 || d < best_d))
+        {
+            best = z;
+            best_d = d;
+        }
+    }
+    if (best < 0 || (cur_d >= 0.0 && best_d + HO_HYST_M >= cur_d))
+        return -1;
+    return best;
+}
+
+/* Received level of the last frame, in dBm, from the Ipatov CIR power (DW3000 User Manual, 4.7.2). */
+static float ho_rx_level(void)
+{
+    dwt_nlos_alldiag_t diag;
+
+    diag.diag_type = IPATOV;
+    if (dwt_nlos_alldiag(&diag) != DWT_SUCCESS || diag.accumCount == 0 || diag.cir_power == 0)
+        return -200.0f;
+    return (float)(10.0 * log10((double)diag.cir_power * (1 << 21) / ((double)diag.accumCount * diag.accumCount)) + 6.0 * diag.D - 121.7);
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn ho_scan()
+ *
+ * @brief Move to a zone and listen to its beacons for HO_SCAN_MS. The DW IC is left in that zone; the caller moves back with zone_switch() if
+ *        it does not hand over. Uses the RX timeout, which the ranging sets again before each poll.
+ *
+ * @param  cfg      configuration in use, updated by zone_switch()
+ * @param  zone     zone to scan
+ * @param  addr     short address of each anchor, as in the frames
+ * @param  zone_of  zone of each anchor
+ * @param  n        number of anchors
+ *
+ * @return number of the zone's anchors heard at HO_MIN_LEVEL_DBM or more
+ */
+int ho_scan(dwt_config_t *cfg, uint8_t zone, const uint16_t *addr, const uint8_t *zone_of, int n)
+{
+    uint8_t frame[HO_BEACON_LEN];
+    uint32_t t0, elapsed, status, heard = 0;
+    uint16_t src;
+    int i, count = 0;
+
+    if (zone_switch(cfg, zone) != DWT_SUCCESS)
+        return 0;
+
+    t0 = portGetTickCnt();
+    while ((elapsed = portGetTickCnt() - t0) < HO_SCAN_MS)
+    {
+        dwt_setrxtimeout((HO_SCAN_MS - elapsed) * 1000);
+        dwt_rxenable(DWT_START_RX_IMMEDIATE);
+        waitforsysstatus(&status, NULL, (DWT_INT_RXFCG_BIT_MASK | SYS_STATUS_ALL_RX_TO | SYS_STATUS_ALL_RX_ERR), 0);
+
+        if ((status & DWT_INT_RXFCG_BIT_MASK) && dwt_getframelength() == HO_BEACON_LEN)
+        {
+            dwt_readrxdata(frame, HO_BEACON_LEN, 0);
+            src = frame[7] | (frame[8] << 8);
+            if (frame[9] == HO_BEACON_FCODE && frame[10] == zone)
+            {
+                for (i = 0; i < n; i++)
+                {
+                    if (addr[i] == src && zone_of[i] == zone && !(heard & (1UL << i)) && ho_rx_level() >= HO_MIN_LEVEL_DBM)
+                    {
+                        heard |= 1UL << i;
+                        count++;
+                    }
+                }
+            }
+        }
+        dwt_writesysstatuslo(DWT_INT_RXFCG_BIT_MASK | SYS_STATUS_ALL_RX_TO | SYS_STATUS_ALL_RX_ERR);
+    }
+    return count;
+}
@@ -0,0 +1,59 @@
+/*! ----------------------------------------------------------------------------
+ *  @file    handover.h
+ *  @brief   Zone handover of tags moving between anchor clusters
+ *
+ *           Every anchor sends a short beacon every HO_BEACON_MS with its zone (zone.h) and the number of tags it serves. The tag tracks the
+ *           quality of its link to its zone (the fraction of its anchors answering) and, from its position, which zone's anchors are nearest.
+ *           When another zone is nearer, or the link is failing, it listens on that zone for one beacon period; if it hears enough of its
+ *           anchors it hands over to it, otherwise it goes back. The tag's position and tracking state are kept across the handover.
+ *
+ *           Beacon: the 10 byte header common to all frames of the examples, broadcast (destination 0xFFFF), function code HO_BEACON_FCODE,
+ *           then the zone (byte 10), the number of tags served (byte 11) and the 2 byte checksum.
+ */
+#ifndef __HANDOVER_H__
+#define __HANDOVER_H__
+
+#include <stdint.h>
+#include <deca_device_api.h>
+#include "trilateration.h"
+
+#define HO_BEACON_FCODE 0xE6
+#define HO_BEACON_LEN   14
+
+/* Beacon period of each anchor, and time a tag listens on a zone (one period and a margin). */
+#define HO_BEACON_MS 100
+#define HO_SCAN_MS   (HO_BEACON_MS + 10)
+
+/* Shortest time between two scans, so that ranging is not starved. */
+#define HO_SCAN_INTERVAL_MS 2000
+
+/* Link quality (fraction of the scheduled anchors answering, averaged over fixes with weight HO_LINK_ALPHA) below which other zones are
+ * scanned even if the position does not point to one. */
+#define HO_LINK_MIN   0.6f
+#define HO_LINK_ALPHA 0.25f
+
+/* Another zone's anchors must be this much nearer on average (metres) to be a candidate, so that a tag on the border does not hand over back
+ * and forth. */
+#define HO_HYST_M 2.0
+
+/* A zone is taken if the beacons of HO_MIN_ANCHORS of its anchors are heard at HO_MIN_LEVEL_DBM or more. */
+#define HO_MIN_ANCHORS   3
+#define HO_MIN_LEVEL_DBM -95.0f
+
+typedef struct
+{
+    float link;            /* Link quality to the current zone, 0 to 1. */
+    uint32_t last_scan_ms; /* Tick count of the last scan. */
+    uint8_t next;          /* Next zone to try when scanning without a candidate. */
+    uint32_t scans;        /* Scans and handovers since ho_init(). */
+    uint32_t handovers;
+} ho_t;
+
+void ho_beacon_build(uint8_t *frame, uint8_t sn, uint16_t src, uint8_t zone, uint8_t tags);
+
+void ho_init(ho_t *ho);
+void ho_link(ho_t *ho, int answered, int scheduled);
+int ho_candidate(const Anchor *tab, const uint8_t *zone_of, int n, const Position *pos, uint8_t cur);
+int ho_scan(dwt_config_t *cfg, uint8_t zone, const uint16_t *addr, const uint8_t *zone_of, int n);
+
+#endif
@@ -71,8 +71,13 @@ static uint8_t rx_resp_msg[] = { 0x41, 0x88, 0, 0xCA, 0xDE, 'V', 'E', 'W', 'A',
 //static uint8_t tx_poll_msg[] = { 0x41, 0x88, 0, 0xCA, 0xDE, 'W', 'A', 'D', 'H', 0xE0, 0, 0 };
 //static uint8_t rx_resp_msg[] = { 0x41, 0x88, 0, 0xCA, 0xDE, 'D', 'H', 'W', 'A', 0xE1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
 
-/* TX메시지 버퍼 */
-static uint8_t distance_message[16] ={0, }; //16바이트 사용함. 2*8=16
+/* Distance frame sent after each exchange: the poll's header (same destination and source) with function code DIST_MSG_FCODE and a sequence
+ * number of its own, then the distance as text. See NOTE 3 below. */
+#define DIST_MSG_FCODE   0xE9
+#define DIST_MSG_TXT_IDX 10
+#define DIST_MSG_TXT_LEN 8
+static uint8_t distance_message[DIST_MSG_TXT_IDX + DIST_MSG_TXT_LEN + 2];
+static uint8_t dist_seq_nb = 0;
 /* Length of the common part of the message (up to and including the function code, see NOTE 3 below). */
 #define ALL_MSG_COMMON_LEN 10
 /* Indexes to access some of the fields in the frames defined above. */
@@ -241,7 +246,10 @@ int ss_twr_initiator(void)
 						dwt_writetxfctrl(fLength+2,0,0); // set the frame control register
 						dwt_starttx(DWT_START_TX_IMMEDIATE); // send the frame
 						*/
-                    sprintf((char*)&distance_message, "%3.2f", distance); //방법 1 : distance_message 배열을 만들어서 distance값을 copy하여 tx에 싣기.
+                    memcpy(distance_message, tx_poll_msg, ALL_MSG_COMMON_LEN);
+                    distance_message[ALL_MSG_SN_IDX] = dist_seq_nb++;
+                    distance_message[ALL_MSG_COMMON_LEN - 1] = DIST_MSG_FCODE;
+                    snprintf((char *)&distance_message[DIST_MSG_TXT_IDX], DIST_MSG_TXT_LEN, "%3.2f", distance); //방법 1 : distance_message 배열을 만들어서 distance값을 copy하여 tx에 싣기.
 
                     //uint8_t* p_distance = (uint8_t*)&distance;
                     //dwt_writetxdata(sizeof(distance), p_distance, 0); /* 방법2 : uint8_t 타입의 포인터를 만들어 distance를 uint8_t로 타입 캐스팅하여 초기화 하기. */
@@ -303,6 +311,8 @@ int ss_twr_initiator(void)
  *    Response message:
  *     - byte 10 -> 13: poll message reception timestamp.
  *     - byte 14 -> 17: response message transmission timestamp.
+ *    Distance message (function code DIST_MSG_FCODE, sent to the responder after each exchange, numbered by its own sequence):
+ *     - byte 10 -> 17: distance in metres as text ("%3.2f"), NUL terminated.
  *    All messages end with a 2-byte checksum automatically set by DW IC.
  * 4. Source and destination addresses are hard coded constants in this example to keep it simple but for a real product every device should have a
  *    unique ID. Here, 16-bit addressing is used to keep the messages as short as possible but, in an actual application, this should be done only
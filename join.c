@@ -0,0 +1,268 @@
+#include <deca_device_api.h>
+#include <port.h>
+#include <shared_functions.h>
+#include "join.h"
+
+/* The 10 byte header common to all frames of the examples. */
+static void join_header(uint8_t *frame, uint8_t sn, uint16_t dst, uint16_t src, uint8_t fcode)
+{
+    frame[0] = 0x41; /* Data frame, 16-bit addressing. */
+    frame[1] = 0x88;
+    frame[2] = sn;
+    frame[3] = 0xCA; /* PAN ID 0xDECA. */
+    frame[4] = 0xDE;
+    frame[5] = (uint8_t)dst;
+    frame[6] = (uint8_t)(dst >> 8);
+    frame[7] = (uint8_t)src;
+    frame[8] = (uint8_t)(src >> 8);
+    frame[9] = fcode;
+}
+
+static void put32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+    return p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+void join_table_init(join_table_t *j, uint16_t base, uint32_t now_ms)
+{
+    int i;
+
+    for (i = 0; i < JOIN_MAX_TAGS; i++)
+        j->e[i].uid = 0;
+    for (i = 0; i < (int)sizeof(j->slot_used); i++)
+        j->slot_used[i] = 0;
+    j->base = base;
+    j->cycle_start_ms = now_ms;
+    j->n = 0;
+}
+
+/* First free slot, taken, or JOIN_NO_SLOT. */
+static uint8_t join_slot_take(join_table_t *j)
+{
+    int s;
+
+    for (s = 0; s < JOIN_SLOTS; s++)
+    {
+        if (!(j->slot_used[s >> 3] & (1 << (s & 7))))
+        {
+            j->slot_used[s >> 3] |= (uint8_t)(1 << (s & 7));
+            return (uint8_t)s;
+        }
+    }
+    return JOIN_NO_SLOT;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn join_table_expire()
+ *
+ * @brief Reclaim the addresses and slots of the leases that have ended.
+ *
+ * @param  j       coordinator table
+ * @param  now_ms  tick count
+ *
+ * @return number of leases left
+ */
+int join_table_expire(join_table_t *j, uint32_t now_ms)
+{
+    join_entry_t *e;
+    int i;
+
+    for (i = 0; i < JOIN_MAX_TAGS; i++)
+    {
+        e = &j->e[i];
+        if (e->uid != 0 && (int32_t)(now_ms - e->expires_ms) >= 0)
+        {
+            if (e->slot != JOIN_NO_SLOT)
+                j->slot_used[e->slot >> 3] &= (uint8_t)~(1 << (e->slot & 7));
+            e->uid = 0;
+            j->n--;
+        }
+    }
+    return j->n;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn join_table_request()
+ *
+ * @brief Serve a join request: renew the lease of a tag already known, by its ID, or give a new one an address and, if one is free, a slot.
+ *        A tag holding no slot gets one as soon as one is free. Expired leases are reclaimed first when a new tag joins.
+ *
+ * @param  j       coordinator table
+ * @param  req     request frame
+ * @param  len     its length
+ * @param  sn      sequence number of the response
+ * @param  src     coordinator's short address
+ * @param  now_ms  tick count
+ * @param  resp    output, response frame, JOIN_RESP_LEN bytes
+ *
+ * @return length of the response to send, 0 if the frame is not a request or the pool is full
+ */
+int join_table_request(join_table_t *j, const uint8_t *req, uint16_t len, uint8_t sn, uint16_t src, uint32_t now_ms, uint8_t *resp)
+{
+    join_entry_t *e;
+    uint32_t uid, wait = 0;
+    uint16_t held;
+    int i;
+
+    if (len != JOIN_REQ_LEN || req[9] != JOIN_REQ_FCODE)
+        return 0;
+    uid = get32(&req[10]);
+    if (uid == 0)
+        return 0;
+
+    /* The address the tag holds first, then the whole pool: a tag that lost its lease may have been given another. */
+    held = req[14] | (req[15] << 8);
+    i = held - j->base;
+    if (held == JOIN_NO_ADDR || i < 0 || i >= JOIN_MAX_TAGS || j->e[i].uid != uid)
+    {
+        for (i = 0; i < JOIN_MAX_TAGS && j->e[i].uid != uid; i++)
+            ;
+    }
+    if (i == JOIN_MAX_TAGS)
+    {
+        join_table_expire(j, now_ms);
+        for (i = 0; i < JOIN_MAX_TAGS && j->e[i].uid != 0; i++)
+            ;
+        if (i == JOIN_MAX_TAGS)
+            return 0;
+        e = &j->e[i];
+        e->uid = uid;
+        e->slot = JOIN_NO_SLOT;
+        j->n++;
+    }
+    e = &j->e[i];
+    if (e->slot == JOIN_NO_SLOT)
+        e->slot = join_slot_take(j);
+    e->expires_ms = now_ms + JOIN_LEASE_MS;
+
+    if (e->slot != JOIN_NO_SLOT)
+        wait = (e->slot * JOIN_SLOT_MS + JOIN_CYCLE_MS - (now_ms - j->cycle_start_ms) % JOIN_CYCLE_MS) % JOIN_CYCLE_MS;
+
+    join_header(resp, sn, 0xFFFF, src, JOIN_RESP_FCODE);
+    put32(&resp[10], uid);
+    resp[14] = (uint8_t)(j->base + i);
+    resp[15] = (uint8_t)((j->base + i) >> 8);
+    resp[16] = e->slot;
+    resp[17] = (uint8_t)wait;
+    resp[18] = (uint8_t)(wait >> 8);
+    resp[19] = (uint8_t)(JOIN_LEASE_MS / 1000);
+    resp[20] = (uint8_t)((JOIN_LEASE_MS / 1000) >> 8);
+    return JOIN_RESP_LEN;
+}
+
+void join_init(join_state_t *js, uint32_t uid)
+{
+    js->uid = uid;
+    join_reset(js);
+}
+
+/* Give up the address and slot, e.g. on leaving the coordinator's zone; the tag joins again. */
+void join_reset(join_state_t *js)
+{
+    js->addr = JOIN_NO_ADDR;
+    js->slot = JOIN_NO_SLOT;
+    js->leased_ms = 0;
+    js->lease_ms = 0;
+    js->slot_ms = 0;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn join_check()
+ *
+ * @brief Give up a lease that has ended without renewal, and tell whether a request is due: not joined, past JOIN_RENEW_MS, or without a
+ *        slot for a cycle.
+ *
+ * @param  js      tag state
+ * @param  now_ms  tick count
+ *
+ * @return 1 if join_exchange() should be run, 0 otherwise
+ */
+int join_check(join_state_t *js, uint32_t now_ms)
+{
+    if (js->addr == JOIN_NO_ADDR)
+        return 1;
+    if (now_ms - js->leased_ms >= js->lease_ms)
+    {
+        join_reset(js);
+        return 1;
+    }
+    if (now_ms - js->leased_ms >= JOIN_RENEW_MS)
+        return 1;
+    /* Without a slot, ask again once a cycle in case one has been freed. */
+    return (js->slot == JOIN_NO_SLOT && now_ms - js->leased_ms >= JOIN_CYCLE_MS) ? 1 : 0;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn join_exchange()
+ *
+ * @brief Send a join request and wait JOIN_RESP_TO_UUS for the coordinator's response. Uses the RX after TX delay and the RX timeout, which
+ *        the ranging sets again before each poll.
+ *
+ * @param  js  tag state, updated with the lease on success
+ * @param  sn  sequence number of the request
+ *
+ * @return 0 if a lease was granted or renewed, -1 otherwise
+ */
+int join_exchange(join_state_t *js, uint8_t sn)
+{
+    uint8_t frame[JOIN_RESP_LEN];
+    uint32_t status, now, wait;
+    int ret = -1;
+
+    join_header(frame, sn, 0xFFFF, js->addr, JOIN_REQ_FCODE);
+    put32(&frame[10], js->uid);
+    frame[14] = (uint8_t)js->addr;
+    frame[15] = (uint8_t)(js->addr >> 8);
+
+    dwt_setrxaftertxdelay(0);
+    dwt_setrxtimeout(JOIN_RESP_TO_UUS);
+    dwt_writetxdata(JOIN_REQ_LEN, frame, 0);
+    dwt_writetxfctrl(JOIN_REQ_LEN, 0, 0);
+    if (dwt_starttx(DWT_START_TX_IMMEDIATE | DWT_RESPONSE_EXPECTED) != DWT_SUCCESS)
+        return -1;
+
+    waitforsysstatus(&status, NULL, (DWT_INT_RXFCG_BIT_MASK | SYS_STATUS_ALL_RX_TO | SYS_STATUS_ALL_RX_ERR), 0);
+    now = portGetTickCnt();
+    if ((status & DWT_INT_RXFCG_BIT_MASK) && dwt_getframelength() == JOIN_RESP_LEN)
+    {
+        dwt_readrxdata(frame, JOIN_RESP_LEN, 0);
+        if (frame[9] == JOIN_RESP_FCODE && get32(&frame[10]) == js->uid)
+        {
+            js->addr = frame[14] | (frame[15] << 8);
+            js->slot = frame[16];
+            wait = frame[17] | (frame[18] << 8);
+            js->leased_ms = now;
+            js->lease_ms = (uint32_t)(frame[19] | (frame[20] << 8)) * 1000;
+            js->slot_ms = now + wait;
+            ret = 0;
+        }
+    }
+    dwt_writesysstatuslo(DWT_INT_TXFRS_BIT_MASK | DWT_INT_RXFCG_BIT_MASK | SYS_STATUS_ALL_RX_TO | SYS_STATUS_ALL_RX_ERR);
+    return ret;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn join_slot_wait()
+ *
+ * @brief Time until the first start of the tag's slot at least min_ms away, moving it on by whole cycles.
+ *
+ * @param  js      tag state, with a slot
+ * @param  now_ms  tick count
+ * @param  min_ms  shortest wait, 0 for the next slot
+ *
+ * @return wait, in milliseconds
+ */
+uint32_t join_slot_wait(join_state_t *js, uint32_t now_ms, uint32_t min_ms)
+{
+    while ((int32_t)(js->slot_ms - now_ms) <= 0 || js->slot_ms - now_ms < min_ms)
+        js->slot_ms += JOIN_CYCLE_MS;
+    return js->slot_ms - now_ms;
+}
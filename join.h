@@ -0,0 +1,81 @@
+/*! ----------------------------------------------------------------------------
+ *  @file    join.h
+ *  @brief   Network join: short address and ranging slot leased to each tag by the coordinator anchor of its zone
+ *
+ *           A tag that has no address sends a join request with its unique ID (the DW IC part ID). The coordinator anchor gives it a 16-bit
+ *           short address from its pool and, while some are free, a slot of JOIN_SLOT_MS in a cycle of JOIN_CYCLE_MS, leased for JOIN_LEASE_MS.
+ *           The tag renews the lease with the same request, carrying its address, from JOIN_RENEW_MS on; a lease not renewed in time is
+ *           reclaimed by the coordinator and given up by the tag, which then joins again.
+ *
+ *           Request: the 10 byte header (source JOIN_NO_ADDR before joining), function code JOIN_REQ_FCODE, the ID (bytes 10 to 13), the address
+ *           held or JOIN_NO_ADDR (14, 15) and the 2 byte checksum.
+ *           Response: the 10 byte header broadcast, function code JOIN_RESP_FCODE, the ID (10 to 13), the address (14, 15), the slot or
+ *           JOIN_NO_SLOT (16), the time to the slot's next start in milliseconds (17, 18), the lease in seconds (19, 20) and the checksum.
+ */
+#ifndef __JOIN_H__
+#define __JOIN_H__
+
+#include <stdint.h>
+
+#define JOIN_REQ_FCODE  0xE7
+#define JOIN_RESP_FCODE 0xE8
+#define JOIN_REQ_LEN    18
+#define JOIN_RESP_LEN   23
+
+/* Source address of a tag that has not joined (IEEE 802.15.4 "no short address"), and slot value of a tag that contends for the channel. */
+#define JOIN_NO_ADDR 0xFFFE
+#define JOIN_NO_SLOT 0xFF
+
+/* Addresses in a coordinator's pool, from the base it is given; the pools of the zones must not overlap. */
+#define JOIN_MAX_TAGS 256
+/* Ranging slots: one run of the tag each, a cycle of JOIN_SLOTS. Tags joining when all slots are taken contend (rand_access.c). */
+#define JOIN_SLOTS    64
+#define JOIN_SLOT_MS  25
+#define JOIN_CYCLE_MS (JOIN_SLOTS * JOIN_SLOT_MS)
+
+/* Lease of an address and slot, and age from which the tag renews it. */
+#define JOIN_LEASE_MS 60000
+#define JOIN_RENEW_MS (JOIN_LEASE_MS / 2)
+
+/* Tag: how long it waits for the coordinator's response, in UWB microseconds. */
+#define JOIN_RESP_TO_UUS 3000
+
+/* Coordinator side. */
+typedef struct
+{
+    uint32_t uid;        /* Tag ID, 0 if the entry is free. */
+    uint32_t expires_ms; /* Tick count at which the lease ends. */
+    uint8_t slot;        /* Slot, or JOIN_NO_SLOT. */
+} join_entry_t;
+
+typedef struct
+{
+    join_entry_t e[JOIN_MAX_TAGS]; /* Entry i holds address base + i. */
+    uint16_t base;
+    uint32_t cycle_start_ms;       /* Start of the slot cycles. */
+    uint8_t slot_used[(JOIN_SLOTS + 7) / 8];
+    uint16_t n;                    /* Leases held. */
+} join_table_t;
+
+/* Tag side. */
+typedef struct
+{
+    uint32_t uid;
+    uint16_t addr;        /* Short address, JOIN_NO_ADDR until joined. */
+    uint8_t slot;
+    uint32_t leased_ms;   /* Tick count of the last grant or renewal. */
+    uint32_t lease_ms;    /* Lease granted. */
+    uint32_t slot_ms;     /* Tick count of the next start of the slot. */
+} join_state_t;
+
+void join_table_init(join_table_t *j, uint16_t base, uint32_t now_ms);
+int join_table_expire(join_table_t *j, uint32_t now_ms);
+int join_table_request(join_table_t *j, const uint8_t *req, uint16_t len, uint8_t sn, uint16_t src, uint32_t now_ms, uint8_t *resp);
+
+void join_init(join_state_t *js, uint32_t uid);
+void join_reset(join_state_t *js);
+int join_check(join_state_t *js, uint32_t now_ms);
+int join_exchange(join_state_t *js, uint8_t sn);
+uint32_t join_slot_wait(join_state_t *js, uint32_t now_ms, uint32_t min_ms);
+
+#endif
@@ -0,0 +1,344 @@
+#include <string.h>
+#include <deca_device_api.h>
+#include <port.h>
+#include <shared_functions.h>
+#include "mesh_relay.h"
+
+typedef struct
+{
+    uint16_t origin;
+    uint8_t seq;
+    uint8_t hops;
+    uint8_t tries;
+    uint8_t len;
+    uint8_t payload[MESH_PAYLOAD_MAX];
+} mesh_msg_t;
+
+mesh_stats_t mesh_stats;
+
+static mesh_cfg_t cfg;
+/* Network time minus local tick count, in milliseconds. */
+static uint32_t net_ofs;
+static uint8_t own_seq;
+static uint8_t link_sn;
+
+/* Queue of messages to send, front is the oldest. */
+static mesh_msg_t queue[MESH_QUEUE_LEN];
+static int q_front, q_count;
+
+/* Recently received messages. */
+static uint16_t dedup_origin[MESH_DEDUP_LEN];
+static uint8_t dedup_seq[MESH_DEDUP_LEN];
+static int dedup_next;
+
+static uint8_t frame[127];
+
+static void put16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put32(uint8_t *p, uint32_t v)
+{
+    put16(p, (uint16_t)v);
+    put16(p + 2, (uint16_t)(v >> 16));
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn mesh_header()
+ *
+ * @brief Fill the common header and the origin fields of a frame to send.
+ *
+ * @param  dst     next hop
+ * @param  fcode   MESH_FCODE_DATA or MESH_FCODE_ACK
+ * @param  origin  origin address of the message
+ * @param  seq     origin sequence number of the message
+ *
+ * @return none
+ */
+static void mesh_header(uint16_t dst, uint8_t fcode, uint16_t origin, uint8_t seq)
+{
+    frame[0] = 0x41; /* Data frame, 16-bit addressing. */
+    frame[1] = 0x88;
+    frame[2] = link_sn++;
+    frame[3] = 0xCA; /* PAN ID 0xDECA. */
+    frame[4] = 0xDE;
+    put16(&frame[5], dst);
+    put16(&frame[7], cfg.own);
+    frame[9] = fcode;
+    put16(&frame[10], origin);
+    frame[12] = seq;
+}
+
+static void mesh_tx(uint16_t len, uint8_t mode)
+{
+    dwt_writetxdata(len, frame, 0); /* Zero offset in TX buffer. */
+    dwt_writetxfctrl(len, 0, 0);    /* Zero offset in TX buffer, no ranging. */
+    dwt_starttx(mode);
+}
+
+void mesh_init(const mesh_cfg_t *c)
+{
+    cfg = *c;
+    net_ofs = 0;
+    own_seq = 0;
+    link_sn = 0;
+    q_front = q_count = 0;
+    dedup_next = 0;
+    memset(dedup_origin, 0, sizeof(dedup_origin));
+    memset(&mesh_stats, 0, sizeof(mesh_stats));
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn mesh_enqueue()
+ *
+ * @brief Add a message at the back of the queue.
+ *
+ * @return 0 on success, -1 if the queue is full or the payload too long
+ */
+static int mesh_enqueue(uint16_t origin, uint8_t seq, uint8_t hops, const uint8_t *payload, uint16_t len)
+{
+    mesh_msg_t *m;
+
+    if (q_count >= MESH_QUEUE_LEN || len > MESH_PAYLOAD_MAX)
+        return -1;
+    m = &queue[(q_front + q_count) % MESH_QUEUE_LEN];
+    m->origin = origin;
+    m->seq = seq;
+    m->hops = hops;
+    m->tries = 0;
+    m->len = (uint8_t)len;
+    memcpy(m->payload, payload, len);
+    q_count++;
+    return 0;
+}
+
+static void mesh_dequeue(void)
+{
+    q_front = (q_front + 1) % MESH_QUEUE_LEN;
+    q_count--;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn mesh_send()
+ *
+ * @brief Queue a message originating from this anchor, sent towards the root from the next slot of this anchor on. On the root the message
+ *        is not queued: it has arrived.
+ *
+ * @param  payload  message
+ * @param  len      length of payload, at most MESH_PAYLOAD_MAX
+ *
+ * @return 0 on success, -1 if the queue is full or the payload too long
+ */
+int mesh_send(const uint8_t *payload, uint16_t len)
+{
+    if (cfg.parent == MESH_NO_PARENT)
+        return -1;
+    if (mesh_enqueue(cfg.own, own_seq, 0, payload, len) != 0)
+    {
+        mesh_stats.dropped++;
+        return -1;
+    }
+    own_seq++;
+    return 0;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn mesh_seen()
+ *
+ * @brief Duplicate detection: tell whether a message was received recently.
+ *
+ * @return 1 if the message is a copy, 0 if it is new
+ */
+static int mesh_seen(uint16_t origin, uint8_t seq)
+{
+    int i;
+
+    for (i = 0; i < MESH_DEDUP_LEN; i++)
+    {
+        if (dedup_origin[i] == origin && dedup_seq[i] == seq)
+            return 1;
+    }
+    return 0;
+}
+
+/* Remember a message accepted, overwriting the oldest one. */
+static void mesh_remember(uint16_t origin, uint8_t seq)
+{
+    dedup_origin[dedup_next] = origin;
+    dedup_seq[dedup_next] = seq;
+    dedup_next = (dedup_next + 1) % MESH_DEDUP_LEN;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn mesh_rx()
+ *
+ * @brief Handle a received frame. A data frame addressed to this anchor is acknowledged at once (in the sender's slot) and, if new, queued
+ *        for the next hop or, on the root, returned. Any mesh frame from the parent sets the network time.
+ *
+ * @param  frame    received frame
+ * @param  len      frame length including the checksum
+ * @param  now_ms   local tick count
+ * @param  payload  output, on the root: message received
+ * @param  plen     output, on the root: length of the message
+ *
+ * @return 1 if a new message arrived at the root, 0 for another mesh frame, -1 if the frame is not a mesh frame for this anchor
+ */
+int mesh_rx(const uint8_t *rx, uint16_t len, uint32_t now_ms, const uint8_t **payload, uint16_t *plen)
+{
+    uint16_t src, dst, origin;
+    uint8_t seq, hops;
+    int fresh;
+
+    if (len < MESH_ACK_LEN || rx[0] != 0x41 || (rx[9] != MESH_FCODE_DATA && rx[9] != MESH_FCODE_ACK))
+        return -1;
+    dst = rx[5] | (rx[6] << 8);
+    src = rx[7] | (rx[8] << 8);
+
+    /* Follow the parent's clock, heard in its acknowledgements and its own data frames. */
+    if (src == cfg.parent && cfg.parent != MESH_NO_PARENT)
+        net_ofs = get32(&rx[rx[9] == MESH_FCODE_DATA ? 14 : 13]) - now_ms;
+
+    if (dst != cfg.own || rx[9] != MESH_FCODE_DATA || len < MESH_HDR_LEN + 2)
+        return (dst == cfg.own) ? 0 : -1;
+
+    origin = rx[10] | (rx[11] << 8);
+    seq = rx[12];
+    hops = rx[13] + 1;
+
+    fresh = !mesh_seen(origin, seq);
+    if (fresh && cfg.parent != MESH_NO_PARENT)
+    {
+        /* No room: no acknowledgement either, the child keeps the message and sends it again. */
+        if (hops > MESH_MAX_HOPS || mesh_enqueue(origin, seq, hops, &rx[MESH_HDR_LEN], len - MESH_HDR_LEN - 2) != 0)
+        {
+            mesh_stats.dropped++;
+            return 0;
+        }
+        mesh_stats.relayed++;
+    }
+    if (fresh)
+        mesh_remember(origin, seq);
+    else
+        mesh_stats.dup++;
+
+    mesh_header(src, MESH_FCODE_ACK, origin, seq);
+    put32(&frame[13], now_ms + net_ofs);
+    mesh_tx(MESH_ACK_LEN, DWT_START_TX_IMMEDIATE);
+    waitforsysstatus(NULL, NULL, DWT_INT_TXFRS_BIT_MASK, 0);
+    dwt_writesysstatuslo(DWT_INT_TXFRS_BIT_MASK);
+
+    if (fresh && cfg.parent == MESH_NO_PARENT)
+    {
+        *payload = &rx[MESH_HDR_LEN];
+        *plen = len - MESH_HDR_LEN - 2;
+        return 1;
+    }
+    return 0;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn mesh_slot_left()
+ *
+ * @brief Time left in this anchor's slot.
+ *
+ * @return milliseconds to the end of the slot, 0 outside the slot
+ */
+static uint32_t mesh_slot_left(uint32_t now_ms)
+{
+    uint32_t t = (now_ms + net_ofs) % (MESH_SLOTS * MESH_SLOT_MS);
+
+    if (t / MESH_SLOT_MS != cfg.slot)
+        return 0;
+    return MESH_SLOT_MS - t % MESH_SLOT_MS;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn mesh_slot()
+ *
+ * @brief In this anchor's slot, send the queued messages to the parent, oldest first, each waiting for its acknowledgement. A message not
+ *        acknowledged stays at the front of the queue for the next attempt, up to MESH_MAX_TRIES. Returns at once outside the slot.
+ *
+ * @param  now_ms  local tick count
+ *
+ * @return none
+ */
+void mesh_slot(uint32_t now_ms)
+{
+    uint8_t ack[MESH_ACK_LEN];
+    uint32_t status;
+
+    while (q_count > 0 && mesh_slot_left(now_ms) >= MESH_TX_MS)
+    {
+        mesh_msg_t *m = &queue[q_front];
+        uint16_t len = MESH_HDR_LEN + m->len + 2;
+        int acked = 0;
+
+        mesh_header(cfg.parent, MESH_FCODE_DATA, m->origin, m->seq);
+        frame[13] = m->hops;
+        put32(&frame[14], now_ms + net_ofs);
+        memcpy(&frame[MESH_HDR_LEN], m->payload, m->len);
+
+        /* The acknowledgement follows at once: receive it right after the TX. */
+        dwt_setrxaftertxdelay(0);
+        dwt_setrxtimeout(MESH_ACK_TIMEOUT_UUS);
+        mesh_tx(len, DWT_START_TX_IMMEDIATE | DWT_RESPONSE_EXPECTED);
+        mesh_stats.sent++;
+        waitforsysstatus(&status, NULL, (DWT_INT_RXFCG_BIT_MASK | SYS_STATUS_ALL_RX_TO | SYS_STATUS_ALL_RX_ERR), 0);
+        if ((status & DWT_INT_RXFCG_BIT_MASK) && dwt_getframelength() == MESH_ACK_LEN)
+        {
+            dwt_readrxdata(ack, MESH_ACK_LEN, 0);
+            acked = (ack[9] == MESH_FCODE_ACK && (ack[5] | (ack[6] << 8)) == cfg.own && (ack[7] | (ack[8] << 8)) == cfg.parent
+                     && (ack[10] | (ack[11] << 8)) == m->origin && ack[12] == m->seq);
+            if (acked)
+                net_ofs = get32(&ack[13]) - now_ms;
+        }
+        dwt_writesysstatuslo(DWT_INT_TXFRS_BIT_MASK | DWT_INT_RXFCG_BIT_MASK | SYS_STATUS_ALL_RX_TO | SYS_STATUS_ALL_RX_ERR);
+        dwt_setrxtimeout(0);
+
+        if (acked)
+        {
+            mesh_stats.acked++;
+            mesh_dequeue();
+        }
+        else if (++m->tries >= MESH_MAX_TRIES)
+        {
+            mesh_stats.dropped++;
+            mesh_dequeue();
+        }
+        else
+        {
+            /* Parent busy or out of range: try again in the next slot. */
+            break;
+        }
+        now_ms = portGetTickCnt();
+    }
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn mesh_wait_ms()
+ *
+ * @brief How long the anchor can listen before mesh_slot() has something to do.
+ *
+ * @param  now_ms  local tick count
+ *
+ * @return milliseconds to the start of this anchor's next slot, 0 if nothing is queued (no limit)
+ */
+uint32_t mesh_wait_ms(uint32_t now_ms)
+{
+    uint32_t frame_ms = MESH_SLOTS * MESH_SLOT_MS;
+    uint32_t t = (now_ms + net_ofs) % frame_ms;
+    uint32_t start = cfg.slot * MESH_SLOT_MS;
+
+    if (q_count == 0)
+        return 0;
+    if (t < start)
+        return start - t;
+    return frame_ms - t + start;
+}
@@ -0,0 +1,73 @@
+/*! ----------------------------------------------------------------------------
+ *  @file    mesh_relay.h
+ *  @brief   Multi-hop relay of reports between anchors over UWB, towards the anchor connected to the network
+ *
+ *           The anchors form a routing tree fixed at installation: each one has a parent, the root being the anchor with Ethernet (the
+ *           gateway). A message (an aggregated report, see report_agg.h) is queued by its origin anchor and sent one hop at a time towards the
+ *           root. Each anchor transmits only in its own TDMA slot of a MESH_SLOTS slot superframe; every data frame is acknowledged by the
+ *           parent and sent again in a later slot if the acknowledgement is missing. The parent drops copies already seen (origin address and
+ *           sequence number) so a lost acknowledgement does not duplicate a report. The slot clock of each anchor follows its parent's, carried
+ *           in the parent's frames, so the whole tree runs on the root's clock.
+ *
+ *           Data frame: the 10 byte header common to all frames of the examples (function code MESH_FCODE_DATA), then:
+ *             - byte 10/11: origin address.
+ *             - byte 12: origin sequence number.
+ *             - byte 13: hops so far.
+ *             - byte 14 -> 17: sender's network time, in milliseconds.
+ *           the payload and the 2 byte checksum. The acknowledgement (MESH_FCODE_ACK) has the same fields without hops and payload.
+ */
+#ifndef __MESH_RELAY_H__
+#define __MESH_RELAY_H__
+
+#include <stdint.h>
+
+#define MESH_FCODE_DATA 0xE4
+#define MESH_FCODE_ACK  0xE5
+
+/* Parent address of the root. */
+#define MESH_NO_PARENT 0
+
+/* Header length and largest payload in a standard frame. */
+#define MESH_HDR_LEN      18
+#define MESH_ACK_LEN      18
+#define MESH_PAYLOAD_MAX  (127 - MESH_HDR_LEN - 2)
+
+/* Superframe: MESH_SLOTS slots of MESH_SLOT_MS. A transmission is only started if MESH_TX_MS remain in the slot. */
+#define MESH_SLOTS   8
+#define MESH_SLOT_MS 10
+#define MESH_TX_MS   4
+
+/* Acknowledgement wait after a data frame (UWB microseconds), transmissions of a message before it is dropped, and largest number of hops. */
+#define MESH_ACK_TIMEOUT_UUS 3000
+#define MESH_MAX_TRIES       8
+#define MESH_MAX_HOPS        8
+
+/* Messages waiting to be sent, and (origin, sequence number) pairs remembered for duplicate detection. */
+#define MESH_QUEUE_LEN 8
+#define MESH_DEDUP_LEN 16
+
+typedef struct
+{
+    uint16_t own;    /* Short address of this anchor. */
+    uint16_t parent; /* Next hop towards the root, MESH_NO_PARENT on the root. */
+    uint8_t slot;    /* TDMA slot, 0 to MESH_SLOTS - 1, unique among anchors in range of each other. */
+} mesh_cfg_t;
+
+typedef struct
+{
+    uint32_t sent;     /* Data frames sent, retries included. */
+    uint32_t acked;    /* Messages acknowledged by the parent. */
+    uint32_t dropped;  /* Messages dropped after MESH_MAX_TRIES, or received with the queue full or too many hops. */
+    uint32_t dup;      /* Copies received again and dropped. */
+    uint32_t relayed;  /* Messages received from children and queued. */
+} mesh_stats_t;
+
+extern mesh_stats_t mesh_stats;
+
+void mesh_init(const mesh_cfg_t *cfg);
+int mesh_send(const uint8_t *payload, uint16_t len);
+int mesh_rx(const uint8_t *frame, uint16_t len, uint32_t now_ms, const uint8_t **payload, uint16_t *plen);
+void mesh_slot(uint32_t now_ms);
+uint32_t mesh_wait_ms(uint32_t now_ms);
+
+#endif
@@ -0,0 +1,77 @@
+#include <deca_device_api.h>
+#include "nlos.h"
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn nlos_init()
+ *
+ * @brief Enable logging of the CIA diagnostics needed by nlos_read(). Call once after dwt_configure().
+ *
+ * @param  none
+ *
+ * @return none
+ */
+void nlos_init(void)
+{
+    dwt_configciadiag(DW_CIA_DIAG_LOG_ALL);
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn nlos_read()
+ *
+ * @brief Classify the last good frame received. It only reads two small diagnostic register sets and does one division, so it can be called
+ *        for every frame, from the polled RX path or from rx_ok_cb(), as long as it runs before RX is re-enabled.
+ *
+ * @param  res  output, class and weight
+ *
+ * @return none
+ */
+void nlos_read(nlos_result_t *res)
+{
+    dwt_nlos_alldiag_t all_diag;
+    dwt_nlos_ipdiag_t index;
+    double f1, f2, f3, fp;
+
+    res->cls = NLOS_CLASS_UNKNOWN;
+    res->weight = NLOS_WEIGHT_POSSIBLE;
+    res->power_ratio = 0.0f;
+
+    all_diag.diag_type = IPATOV;
+    if (dwt_nlos_alldiag(&all_diag) != DWT_SUCCESS)
+        return;
+
+    /* Both powers are scaled by the same accumulator count, DGC and constant, so only their ratio is needed and no log is taken. The F values
+     * carry 2 extra fractional bits and the CIR power is scaled down by 2^21. */
+    f1 = all_diag.F1 / 4.0;
+    f2 = all_diag.F2 / 4.0;
+    f3 = all_diag.F3 / 4.0;
+    fp = f1 * f1 + f2 * f2 + f3 * f3;
+    if (fp <= 0.0)
+        return;
+    res->power_ratio = (float)(((double)all_diag.cir_power * (1 << 21)) / fp);
+
+    if (res->power_ratio < NLOS_RATIO_LOS)
+    {
+        res->cls = NLOS_CLASS_LOS;
+        res->weight = NLOS_WEIGHT_LOS;
+    }
+    else if (res->power_ratio < NLOS_RATIO_NLOS)
+    {
+        /* Not conclusive from power alone: a late peak means the direct path is attenuated. The indexes have 6 fractional bits. */
+        dwt_nlos_ipdiag(&index);
+        if ((int32_t)(index.index_pp_u32 - index.index_fp_u32) / 64.0 > NLOS_PEAK_FP_TAPS)
+        {
+            res->cls = NLOS_CLASS_NLOS;
+            res->weight = NLOS_WEIGHT_NLOS;
+        }
+        else
+        {
+            res->cls = NLOS_CLASS_POSSIBLE;
+            res->weight = NLOS_WEIGHT_POSSIBLE;
+        }
+    }
+    else
+    {
+        res->cls = NLOS_CLASS_NLOS;
+        res->weight = NLOS_WEIGHT_NLOS;
+    }
+}
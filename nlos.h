@@ -0,0 +1,42 @@
+/*! ----------------------------------------------------------------------------
+ *  @file    nlos.h
+ *  @brief   LOS/NLOS classification of received frames from the DW IC CIR diagnostics
+ *
+ *           Compares the first path power with the total received power of the Ipatov CIR and, when that is not conclusive, the distance between
+ *           the first path and the peak path. The result carries a weight for the range measured with the frame.
+ */
+#ifndef __NLOS_H__
+#define __NLOS_H__
+
+#include <stdint.h>
+
+/* Received power minus first path power thresholds, as linear power ratios: 6 dB and 10 dB. */
+#define NLOS_RATIO_LOS  3.98
+#define NLOS_RATIO_NLOS 10.0
+/* Peak path more than this many CIR taps after the first path marks a "possible NLOS" frame as NLOS. */
+#define NLOS_PEAK_FP_TAPS 3.3
+
+/* Weights given to the range for each class. */
+#define NLOS_WEIGHT_LOS      1.0f
+#define NLOS_WEIGHT_POSSIBLE 0.5f
+#define NLOS_WEIGHT_NLOS     0.1f
+
+typedef enum
+{
+    NLOS_CLASS_LOS = 0,
+    NLOS_CLASS_POSSIBLE,
+    NLOS_CLASS_NLOS,
+    NLOS_CLASS_UNKNOWN
+} nlos_class_e;
+
+typedef struct
+{
+    nlos_class_e cls;
+    float weight;      /* Weight of the range, NLOS_WEIGHT_xxx. */
+    float power_ratio; /* Received power over first path power (linear). */
+} nlos_result_t;
+
+void nlos_init(void);
+void nlos_read(nlos_result_t *res);
+
+#endif
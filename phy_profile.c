@@ -0,0 +1,212 @@
+#include <deca_device_api.h>
+#include <shared_defines.h>
+#include <shared_functions.h>
+#include "phy_profile.h"
+
+/* Symbol durations in picoseconds: preamble symbol at 64 MHz PRF, and coded bit (data and PHY header) at 6.8 Mbps and 850 kbps. */
+#define PHY_PRE_SYM_PS  1017630ULL
+#define PHY_BIT_PS_6M8  128210ULL
+#define PHY_BIT_PS_850K 1025640ULL
+/* PHY header bits, and Reed-Solomon parity bits added to each block of data bits. */
+#define PHY_PHR_BITS      21
+#define PHY_RS_BLOCK_BITS 330
+#define PHY_RS_PARITY     48
+
+const phy_profile_t phy_profiles[PHY_PROFILE_NUM] = {
+    /* The delays keep PHY_PROFILE_STD's margins: the responder has the same time to turn around once the poll is in, and the initiator's RX
+     * opens as long before the response's preamble and times out as long after its RMARKER. */
+    { "SHORT",
+      { 5, DWT_PLEN_64, DWT_PAC8, 9, 9, 1, DWT_BR_6M8, DWT_PHRMODE_STD, DWT_PHRRATE_STD, (65 + 8 - 8), DWT_STS_MODE_OFF, DWT_STS_LEN_64, DWT_PDOA_M0 },
+      590, 245, 340 },
+    { "STD",
+      { 5, DWT_PLEN_128, DWT_PAC8, 9, 9, 1, DWT_BR_6M8, DWT_PHRMODE_STD, DWT_PHRRATE_STD, (129 + 8 - 8), DWT_STS_MODE_OFF, DWT_STS_LEN_64, DWT_PDOA_M0 },
+      650, 240, 400 },
+    { "LONG",
+      { 5, DWT_PLEN_1024, DWT_PAC32, 9, 9, 2, DWT_BR_850K, DWT_PHRMODE_STD, DWT_PHRRATE_STD, (1025 + 16 - 32), DWT_STS_MODE_OFF, DWT_STS_LEN_64, DWT_PDOA_M0 },
+      1700, 240, 1330 },
+};
+
+/* Frame sent by phy_bench(), zeroed: not a data frame, so the frame filter of any listening device drops it. */
+static uint8_t bench_frame[127];
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn phy_reconfigure()
+ *
+ * @brief Switch the DW IC to a profile: stop any TX/RX, then dwt_configure() with the profile's configuration, which is copied to cfg except
+ *        for the channel and preamble codes, those of the zone in use (zone.c). The settings written on top of dwt_configure() (TX
+ *        spectrum, antenna delays, addresses, frame filter) are kept. On success profile is pointed at the new profile, whose delays the
+ *        caller's timing reads, and app_config is called to rewrite what depends on them: the RX after TX delay and timeout, and the
+ *        response delay state of reply_tune.c, which belongs to the old profile's range. A device using dw_boot() must call
+ *        dw_boot_invalidate() after a switch, as the warm restart signature is that of the configuration it booted with.
+ *
+ * @param  cfg         in/out, configuration now in use
+ * @param  id          profile
+ * @param  profile     output, profile now in use, or NULL
+ * @param  app_config  settings depending on the profile, or NULL
+ *
+ * @return DWT_SUCCESS, or DWT_ERROR if dwt_configure() failed
+ */
+int phy_reconfigure(dwt_config_t *cfg, phy_profile_id_e id, const phy_profile_t **profile, void (*app_config)(void))
+{
+    uint8_t chan = cfg->chan, tx_code = cfg->txCode, rx_code = cfg->rxCode;
+
+    *cfg = phy_profiles[id].config;
+    cfg->chan = chan;
+    cfg->txCode = tx_code;
+    cfg->rxCode = rx_code;
+    dwt_forcetrxoff();
+    if (dwt_configure(cfg))
+        return DWT_ERROR;
+
+    if (profile)
+        *profile = &phy_profiles[id];
+    if (app_config)
+        app_config();
+    return DWT_SUCCESS;
+}
+
+static uint32_t phy_plen(uint8_t plen)
+{
+    switch (plen)
+    {
+    case DWT_PLEN_64:
+        return 64;
+    case DWT_PLEN_256:
+        return 256;
+    case DWT_PLEN_512:
+        return 512;
+    case DWT_PLEN_1024:
+        return 1024;
+    default:
+        return 128;
+    }
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn phy_shr_us()
+ *
+ * @brief Air time of the synchronisation header (preamble and SFD), up to the RMARKER.
+ *
+ * @param  cfg  configuration, STS off
+ *
+ * @return microseconds, rounded up
+ */
+uint32_t phy_shr_us(const dwt_config_t *cfg)
+{
+    uint64_t ps = (phy_plen(cfg->txPreambLength) + (cfg->sfdType == 2 ? 16 : 8)) * PHY_PRE_SYM_PS;
+
+    return (uint32_t)((ps + 999999) / 1000000);
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn phy_tail_us()
+ *
+ * @brief Air time of the PHY header and the payload, after the RMARKER.
+ *
+ * @param  cfg  configuration
+ * @param  len  frame length including the 2 byte checksum
+ *
+ * @return microseconds, rounded up
+ */
+uint32_t phy_tail_us(const dwt_config_t *cfg, uint16_t len)
+{
+    uint64_t bit_ps = (cfg->dataRate == DWT_BR_850K) ? PHY_BIT_PS_850K : PHY_BIT_PS_6M8;
+    uint64_t phr_ps = (cfg->phrRate == DWT_PHRRATE_STD) ? PHY_BIT_PS_850K : bit_ps;
+    uint32_t bits = len * 8;
+    uint64_t ps;
+
+    bits += (bits + PHY_RS_BLOCK_BITS - 1) / PHY_RS_BLOCK_BITS * PHY_RS_PARITY;
+    ps = PHY_PHR_BITS * phr_ps + bits * bit_ps;
+    return (uint32_t)((ps + 999999) / 1000000);
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn phy_exchange_us()
+ *
+ * @brief Air time of one SS-TWR exchange, from the start of the poll to the end of the response: poll synchronisation header, response
+ *        delay (RMARKER to RMARKER, a UWB microsecond being a microsecond to within 0.01%) and response after its RMARKER.
+ *
+ * @param  p         profile
+ * @param  resp_len  response length including the checksum
+ *
+ * @return microseconds
+ */
+uint32_t phy_exchange_us(const phy_profile_t *p, uint16_t resp_len)
+{
+    return phy_shr_us(&p->config) + p->reply_dly_uus + phy_tail_us(&p->config, resp_len);
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn phy_bench_tx()
+ *
+ * @brief Average time from the TX start command to the end of frame event, over PHY_BENCH_FRAMES frames.
+ *
+ * @param  len  frame length including the checksum
+ *
+ * @return microseconds
+ */
+static uint32_t phy_bench_tx(uint16_t len)
+{
+    uint64_t sum = 0;
+    uint32_t t0;
+    int i;
+
+    dwt_writetxdata(len, bench_frame, 0); /* Zero offset in TX buffer. */
+    dwt_writetxfctrl(len, 0, 0);          /* Zero offset in TX buffer, no ranging. */
+    for (i = 0; i < PHY_BENCH_FRAMES; i++)
+    {
+        /* System time high 32 bits count in units of 256 device time units. */
+        t0 = dwt_readsystimestamphi32();
+        dwt_starttx(DWT_START_TX_IMMEDIATE);
+        waitforsysstatus(NULL, NULL, DWT_INT_TXFRS_BIT_MASK, 0);
+        sum += dwt_readsystimestamphi32() - t0;
+        dwt_writesysstatuslo(DWT_INT_TXFRS_BIT_MASK);
+    }
+    return (uint32_t)((sum << 8) / UUS_TO_DWT_TIME / PHY_BENCH_FRAMES);
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn phy_bench()
+ *
+ * @brief Measure the air time of a poll and a response in each profile, and from them the air time of an exchange. The time measured also
+ *        holds the TX start-up and the status polling, a few microseconds. The DW IC is put back in the configuration cfg held on entry.
+ *        Frames are sent, so run it where it does not disturb a live installation.
+ *
+ * @param  cfg       configuration in use, restored on return
+ * @param  poll_len  poll length including the checksum
+ * @param  resp_len  response length including the checksum
+ * @param  res       output, one result per profile
+ *
+ * @return DWT_SUCCESS, or DWT_ERROR if a profile could not be configured
+ */
+int phy_bench(dwt_config_t *cfg, uint16_t poll_len, uint16_t resp_len, phy_bench_t res[PHY_PROFILE_NUM])
+{
+    dwt_config_t saved = *cfg;
+    int i, ret = DWT_SUCCESS;
+
+    for (i = 0; i < PHY_PROFILE_NUM; i++)
+    {
+        const phy_profile_t *p = &phy_profiles[i];
+        uint32_t poll_shr, resp_tail;
+
+        if (phy_reconfigure(cfg, (phy_profile_id_e)i, NULL, NULL) != DWT_SUCCESS)
+        {
+            ret = DWT_ERROR;
+            break;
+        }
+        res[i].poll_us = phy_bench_tx(poll_len);
+        res[i].resp_us = phy_bench_tx(resp_len);
+
+        /* Split the measured frames at the RMARKER with the computed lengths of the parts outside the exchange. */
+        poll_shr = res[i].poll_us - phy_tail_us(cfg, poll_len);
+        resp_tail = res[i].resp_us - phy_shr_us(cfg);
+        res[i].xchg_us = poll_shr + p->reply_dly_uus + resp_tail;
+        res[i].calc_us = phy_exchange_us(p, resp_len);
+    }
+
+    *cfg = saved;
+    dwt_forcetrxoff();
+    if (dwt_configure(cfg))
+        ret = DWT_ERROR;
+    return ret;
+}
@@ -0,0 +1,56 @@
+/*! ----------------------------------------------------------------------------
+ *  @file    phy_profile.h
+ *  @brief   Named PHY configurations and the delays that go with them
+ *
+ *           Each profile is a dwt_config_t with the SS-TWR delays matching its preamble length and data rate: the responder's response delay,
+ *           and the initiator's RX after TX delay and RX timeout. PHY_PROFILE_SHORT trades range for air time (dense installations, short
+ *           ranges), PHY_PROFILE_LONG the other way round; PHY_PROFILE_STD is the configuration the examples have always used. All devices
+ *           ranging together must use the same profile. The channel and preamble code set here are those of zone 0, see zone.h. phy_reconfigure() switches profile at run time; phy_bench() measures the air time of
+ *           an exchange in each profile.
+ */
+#ifndef __PHY_PROFILE_H__
+#define __PHY_PROFILE_H__
+
+#include <stdint.h>
+#include <deca_device_api.h>
+
+typedef enum
+{
+    PHY_PROFILE_SHORT = 0, /* 64 symbol preamble, 6.8 Mbps. */
+    PHY_PROFILE_STD,       /* 128 symbol preamble, 6.8 Mbps. */
+    PHY_PROFILE_LONG,      /* 1024 symbol preamble, 850 kbps. */
+    PHY_PROFILE_NUM
+} phy_profile_id_e;
+
+typedef struct
+{
+    const char *name;
+    dwt_config_t config;
+    uint16_t reply_dly_uus;   /* Responder: poll RX to response TX (POLL_RX_TO_RESP_TX_DLY_UUS). */
+    uint16_t resp_rx_dly_uus; /* Initiator: poll TX to response RX (POLL_TX_TO_RESP_RX_DLY_UUS). */
+    uint16_t resp_rx_to_uus;  /* Initiator: response RX timeout (RESP_RX_TIMEOUT_UUS). */
+} phy_profile_t;
+
+extern const phy_profile_t phy_profiles[PHY_PROFILE_NUM];
+
+/* Shift of a profile's response delay from PHY_PROFILE_STD's, by which the reply_tune.c tuning range moves. */
+#define PHY_REPLY_OFS_UUS(p) ((int16_t)((p)->reply_dly_uus - phy_profiles[PHY_PROFILE_STD].reply_dly_uus))
+
+/* Frames sent of each length per profile by phy_bench(). */
+#define PHY_BENCH_FRAMES 16
+
+typedef struct
+{
+    uint32_t poll_us; /* Poll frame, measured from the TX start command to the end of frame. */
+    uint32_t resp_us; /* Response frame, likewise. */
+    uint32_t xchg_us; /* Poll start to response end, from the measured frames and the profile's response delay. */
+    uint32_t calc_us; /* The same, computed by phy_exchange_us(). */
+} phy_bench_t;
+
+int phy_reconfigure(dwt_config_t *cfg, phy_profile_id_e id, const phy_profile_t **profile, void (*app_config)(void));
+uint32_t phy_shr_us(const dwt_config_t *cfg);
+uint32_t phy_tail_us(const dwt_config_t *cfg, uint16_t len);
+uint32_t phy_exchange_us(const phy_profile_t *p, uint16_t resp_len);
+int phy_bench(dwt_config_t *cfg, uint16_t poll_len, uint16_t resp_len, phy_bench_t res[PHY_PROFILE_NUM]);
+
+#endif
@@ -0,0 +1,125 @@
+#include <deca_device_api.h>
+#include <port.h>
+#include <shared_functions.h>
+#include "rand_access.h"
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn ra_init()
+ *
+ * @brief Start with the smallest backoff window.
+ *
+ * @param  ra       state
+ * @param  seed     random seed, different on each tag (e.g. from the DW IC part and lot IDs)
+ * @param  slot_ms  contention slot, about the air time of one run
+ *
+ * @return none
+ */
+void ra_init(ra_t *ra, uint32_t seed, uint32_t slot_ms)
+{
+    ra->seed = seed ? seed : 0x2545F491UL;
+    ra->slot_ms = slot_ms;
+    ra->exp = RA_EXP_MIN;
+    ra->runs = ra->collisions = ra->busy = 0;
+}
+
+/* xorshift32: a few cycles, and enough to spread the waits of the tags. */
+static uint32_t ra_rand(ra_t *ra)
+{
+    uint32_t x = ra->seed;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    ra->seed = x;
+    return x;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn ra_backoff_ms()
+ *
+ * @brief Draw a wait of 0 to 2^exp - 1 contention slots.
+ *
+ * @param  ra  state
+ *
+ * @return wait, in milliseconds
+ */
+uint32_t ra_backoff_ms(ra_t *ra)
+{
+    return (ra_rand(ra) & ((1UL << ra->exp) - 1)) * ra->slot_ms;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn ra_feedback()
+ *
+ * @brief Account for the outcome of a run: no answer at all means a collision and doubles the backoff window, an answer resets it.
+ *
+ * @param  ra        state
+ * @param  answered  non-zero if at least one response was received in the run
+ *
+ * @return none
+ */
+void ra_feedback(ra_t *ra, int answered)
+{
+    ra->runs++;
+    if (answered)
+    {
+        ra->exp = RA_EXP_MIN;
+    }
+    else
+    {
+        ra->collisions++;
+        if (ra->exp < RA_EXP_MAX)
+            ra->exp++;
+    }
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn ra_channel_clear()
+ *
+ * @brief Listen for RA_CCA_PACS PACs. Only a preamble can be detected, so a frame whose preamble is already over is not seen; the listen covers
+ *        a whole preamble of the standard profile.
+ *
+ * @param  none
+ *
+ * @return 1 if no preamble was detected, 0 if the channel is busy
+ */
+int ra_channel_clear(void)
+{
+    uint32_t status;
+
+    dwt_setpreambledetecttimeout(RA_CCA_PACS);
+    dwt_rxenable(DWT_START_RX_IMMEDIATE);
+    waitforsysstatus(&status, NULL, (DWT_INT_RXPRD_BIT_MASK | SYS_STATUS_ALL_RX_TO | SYS_STATUS_ALL_RX_ERR), 0);
+
+    /* Leave the frame being received, if any, to its sender. */
+    dwt_forcetrxoff();
+    dwt_writesysstatuslo(DWT_INT_RXPRD_BIT_MASK | DWT_INT_RXFCG_BIT_MASK | SYS_STATUS_ALL_RX_TO | SYS_STATUS_ALL_RX_ERR);
+    dwt_setpreambledetecttimeout(0);
+
+    return (status & DWT_INT_RXPRD_BIT_MASK) ? 0 : 1;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn ra_access()
+ *
+ * @brief Listen before a run and back off while the channel is busy, the window widening at each busy listen as after a collision.
+ *
+ * @param  ra  state
+ *
+ * @return 0 if the channel is clear, -1 if it was still busy after RA_MAX_BUSY listens (the caller polls anyway, as slotted ALOHA would)
+ */
+int ra_access(ra_t *ra)
+{
+    int tries;
+
+    for (tries = 0; tries < RA_MAX_BUSY; tries++)
+    {
+        if (ra_channel_clear())
+            return 0;
+        ra->busy++;
+        if (ra->exp < RA_EXP_MAX)
+            ra->exp++;
+        Sleep(ra_backoff_ms(ra));
+    }
+    return -1;
+}
@@ -0,0 +1,40 @@
+/*! ----------------------------------------------------------------------------
+ *  @file    rand_access.h
+ *  @brief   Contention access with random exponential backoff, for tags without a slot
+ *
+ *           A tag that has no slot of its own waits a random number of contention slots between runs (slotted ALOHA) and listens for a
+ *           preamble before polling (CSMA): while the channel is busy it backs off and listens again. A run in which no anchor answers within
+ *           the response timeout is taken as a collision and widens the backoff window, which doubles up to 2^RA_EXP_MAX slots; a run that gets
+ *           an answer brings it back to 2^RA_EXP_MIN. Tags that collide so draw different waits and drift apart, and the window follows the
+ *           number of tags contending.
+ */
+#ifndef __RAND_ACCESS_H__
+#define __RAND_ACCESS_H__
+
+#include <stdint.h>
+
+/* Backoff window exponents: the wait is 0 to 2^exp - 1 slots. */
+#define RA_EXP_MIN 2
+#define RA_EXP_MAX 7
+
+/* Preamble detection time of a listen, in PACs, and listens in a row that may find the channel busy before polling anyway. */
+#define RA_CCA_PACS 16
+#define RA_MAX_BUSY 5
+
+typedef struct
+{
+    uint32_t seed;       /* Random generator state, never 0. */
+    uint32_t slot_ms;    /* Contention slot. */
+    uint8_t exp;         /* Current backoff window exponent. */
+    uint32_t runs;       /* Runs, collisions and busy listens since ra_init(). */
+    uint32_t collisions;
+    uint32_t busy;
+} ra_t;
+
+void ra_init(ra_t *ra, uint32_t seed, uint32_t slot_ms);
+uint32_t ra_backoff_ms(ra_t *ra);
+void ra_feedback(ra_t *ra, int answered);
+int ra_channel_clear(void);
+int ra_access(ra_t *ra);
+
+#endif
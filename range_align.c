@@ -0,0 +1,129 @@
+#include <math.h>
+#include <deca_device_api.h>
+#include "range_align.h"
+
+#define ALIGN_DW_MASK 0xFFFFFFFFFFULL
+
+void range_stamp_reset(range_stamp_t *r)
+{
+    r->valid = 0;
+    r->rate_ok = 0;
+    r->rate = 0.0f;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn range_stamp_dt_ms()
+ *
+ * @brief Time from range b to range a, in ms, negative if a is older.
+ *
+ * @param  a, b  stamped ranges
+ *
+ * @return a - b in ms
+ */
+double range_stamp_dt_ms(const range_stamp_t *a, const range_stamp_t *b)
+{
+    int32_t dtick = (int32_t)(a->tick_ms - b->tick_ms);
+    int64_t d;
+
+    if (a->epoch != b->epoch || dtick > ALIGN_DW_SPAN_MS || dtick < -ALIGN_DW_SPAN_MS)
+        return (double)dtick;
+
+    /* Signed 40-bit difference. */
+    d = (int64_t)((a->ts - b->ts) & ALIGN_DW_MASK);
+    if (d & 0x8000000000LL)
+        d -= 0x10000000000LL;
+    return (double)d * DWT_TIME_UNITS * 1000.0;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn range_stamp()
+ *
+ * @brief Record a new range to an anchor. The range rate is updated from the previous range when that one is recent enough, and dropped
+ *        when the new rate is not plausible.
+ *
+ * @param  r        stamp of the anchor
+ * @param  dist     range, metres
+ * @param  ts       DW IC system time of the exchange
+ * @param  tick_ms  tick count of the exchange
+ * @param  epoch    DW IC time base of ts
+ *
+ * @return none
+ */
+void range_stamp(range_stamp_t *r, float dist, uint64_t ts, uint32_t tick_ms, uint16_t epoch)
+{
+    range_stamp_t prev = *r;
+    double dt;
+    float rate;
+
+    r->ts = ts & ALIGN_DW_MASK;
+    r->tick_ms = tick_ms;
+    r->epoch = epoch;
+    r->dist = dist;
+    r->valid = 1;
+
+    if (!prev.valid)
+        return;
+
+    dt = range_stamp_dt_ms(r, &prev);
+    if (dt <= 0.0 || dt > ALIGN_RATE_GAP_MS)
+    {
+        r->rate_ok = 0;
+        return;
+    }
+
+    rate = (float)((dist - prev.dist) * 1000.0 / dt);
+    if (fabsf(rate) > ALIGN_RATE_MAX)
+    {
+        r->rate_ok = 0;
+        return;
+    }
+    r->rate = prev.rate_ok ? prev.rate + ALIGN_RATE_ALPHA * (rate - prev.rate) : rate;
+    r->rate_ok = 1;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn range_align()
+ *
+ * @brief Bring a set of ranges to the time of the newest one (see range_align.h).
+ *
+ * @param  r          stamped ranges, invalid ones are rejected
+ * @param  n          number of ranges
+ * @param  window_ms  ranges this close to the newest are used as they are
+ * @param  extrap_ms  ranges up to this old are extrapolated, older ones rejected
+ * @param  dist       output, aligned ranges
+ * @param  keep       output, 1 for each range kept
+ *
+ * @return number of ranges kept
+ */
+int range_align(const range_stamp_t *r, int n, uint32_t window_ms, uint32_t extrap_ms, double *dist, uint8_t *keep)
+{
+    int i, ref = -1, kept = 0;
+
+    for (i = 0; i < n; i++)
+        if (r[i].valid && (ref < 0 || range_stamp_dt_ms(&r[i], &r[ref]) > 0.0))
+            ref = i;
+
+    for (i = 0; i < n; i++)
+    {
+        double age;
+
+        keep[i] = 0;
+        dist[i] = 0.0;
+        if (!r[i].valid)
+            continue;
+
+        age = range_stamp_dt_ms(&r[ref], &r[i]);
+        if (age <= window_ms)
+            dist[i] = r[i].dist;
+        else if (age <= extrap_ms && r[i].rate_ok)
+            dist[i] = r[i].dist + r[i].rate * age / 1000.0;
+        else
+            continue;
+
+        if (dist[i] <= 0.0)
+            continue;
+        keep[i] = 1;
+        kept++;
+    }
+    return kept;
+}
@@ -0,0 +1,47 @@
+/*! ----------------------------------------------------------------------------
+ *  @file    range_align.h
+ *  @brief   Time stamping of ranges and their alignment to one instant before a fix
+ *
+ *           Each range is stamped with the DW IC system time of its exchange and the MCU tick count. When ranges to several anchors are
+ *           combined, their ages are taken relative to the newest one: ranges within a window of it are used as they are, older ones up to
+ *           an extrapolation limit are moved forward along their range rate (from the previous ranges to the same anchor), and the others
+ *           are rejected. Both are set by the caller, ALIGN_WINDOW_MS and ALIGN_EXTRAP_MS suit ranges taken every few tens of ms.
+ *
+ *           Ages come from the DW IC system time, 15.65 ps resolution, when both ranges are in the same DW IC time base (epoch) and less
+ *           than ALIGN_DW_SPAN_MS apart (the 40-bit counter wraps every 17.2 s). The caller changes the epoch whenever the DW IC system time
+ *           restarts, e.g. after each wake up from DEEPSLEEP; across epochs the tick count is used.
+ */
+#ifndef __RANGE_ALIGN_H__
+#define __RANGE_ALIGN_H__
+
+#include <stdint.h>
+
+#define ALIGN_WINDOW_MS  30
+#define ALIGN_EXTRAP_MS  300
+
+/* Range rate: smoothing factor, largest rate trusted (m/s) and largest gap between the two ranges it is taken from (ms). The gap covers the
+ * ranges of a tag at the 5 s heartbeat of rate_ctrl.c, one per anchor and fix, with a contention backoff on top. */
+#define ALIGN_RATE_ALPHA  0.5f
+#define ALIGN_RATE_MAX    5.0f
+#define ALIGN_RATE_GAP_MS 7000
+
+/* DW IC system time differences are used below this tick count difference. */
+#define ALIGN_DW_SPAN_MS 8000
+
+typedef struct
+{
+    uint64_t ts;      /* DW IC system time of the range, 40 bits. */
+    uint32_t tick_ms; /* Tick count of the range. */
+    uint16_t epoch;   /* DW IC time base of ts. */
+    uint8_t valid;
+    uint8_t rate_ok;
+    float dist;       /* Range, metres. */
+    float rate;       /* Range rate, m/s. */
+} range_stamp_t;
+
+void range_stamp_reset(range_stamp_t *r);
+void range_stamp(range_stamp_t *r, float dist, uint64_t ts, uint32_t tick_ms, uint16_t epoch);
+double range_stamp_dt_ms(const range_stamp_t *a, const range_stamp_t *b);
+int range_align(const range_stamp_t *r, int n, uint32_t window_ms, uint32_t extrap_ms, double *dist, uint8_t *keep);
+
+#endif
@@ -0,0 +1,74 @@
+#include <math.h>
+#include "range_filter.h"
+
+void range_burst_reset(range_burst_t *b)
+{
+    b->n = 0;
+}
+
+void range_burst_add(range_burst_t *b, float dist)
+{
+    if (b->n < RANGE_BURST_MAX)
+        b->d[b->n++] = dist;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn range_burst_reduce()
+ *
+ * @brief Reduce the burst to one distance. Samples are sorted, the ones further than RANGE_OUTLIER_M from the median are dropped, then
+ *        RANGE_TRIM_FRAC of the rest is trimmed at each end and the remaining samples are averaged. The samples are reordered.
+ *
+ * @param  b     burst
+ * @param  dist  output, reduced distance in metres
+ * @param  var   output, variance of the samples kept, in square metres
+ *
+ * @return number of samples used, 0 if the burst is empty
+ */
+int range_burst_reduce(range_burst_t *b, float *dist, float *var)
+{
+    float median, sum, sq;
+    int lo, hi, trim, i, j;
+
+    if (b->n == 0)
+        return 0;
+
+    /* Insertion sort, the burst is short. */
+    for (i = 1; i < b->n; i++)
+    {
+        float v = b->d[i];
+        for (j = i - 1; j >= 0 && b->d[j] > v; j--)
+            b->d[j + 1] = b->d[j];
+        b->d[j + 1] = v;
+    }
+
+    median = (b->n & 1) ? b->d[b->n / 2] : 0.5f * (b->d[b->n / 2 - 1] + b->d[b->n / 2]);
+
+    lo = 0;
+    hi = b->n;
+    while (lo < hi && median - b->d[lo] > RANGE_OUTLIER_M)
+        lo++;
+    while (hi > lo && b->d[hi - 1] - median > RANGE_OUTLIER_M)
+        hi--;
+
+    trim = (int)((hi - lo) * RANGE_TRIM_FRAC);
+    lo += trim;
+    hi -= trim;
+    if (hi <= lo)
+    {
+        *dist = median;
+        *var = 0.0f;
+        return 1;
+    }
+
+    sum = 0.0f;
+    for (i = lo; i < hi; i++)
+        sum += b->d[i];
+    *dist = sum / (hi - lo);
+
+    sq = 0.0f;
+    for (i = lo; i < hi; i++)
+        sq += (b->d[i] - *dist) * (b->d[i] - *dist);
+    *var = (hi - lo > 1) ? sq / (hi - lo - 1) : 0.0f;
+
+    return hi - lo;
+}
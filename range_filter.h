@@ -0,0 +1,31 @@
+/*! ----------------------------------------------------------------------------
+ *  @file    range_filter.h
+ *  @brief   Reduction of a burst of SS TWR range samples
+ *
+ *           Collects the distances of N back-to-back exchanges with one anchor and reduces them to one distance (trimmed mean around the median,
+ *           with outlier rejection) and its variance, which downstream solvers can use as a quality metric.
+ */
+#ifndef __RANGE_FILTER_H__
+#define __RANGE_FILTER_H__
+
+#include <stdint.h>
+
+/* Maximum number of samples in one burst. */
+#define RANGE_BURST_MAX 16
+
+/* Samples further than this from the median are rejected before averaging, in metres. */
+#define RANGE_OUTLIER_M 0.5f
+/* Fraction of the remaining samples dropped at each end before averaging. */
+#define RANGE_TRIM_FRAC 0.2f
+
+typedef struct
+{
+    int n;                     /* Number of samples collected. */
+    float d[RANGE_BURST_MAX];  /* Distances, in metres. */
+} range_burst_t;
+
+void range_burst_reset(range_burst_t *b);
+void range_burst_add(range_burst_t *b, float dist);
+int range_burst_reduce(range_burst_t *b, float *dist, float *var);
+
+#endif
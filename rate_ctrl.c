@@ -0,0 +1,96 @@
+#include <math.h>
+#include "rate_ctrl.h"
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn rate_ctrl_init()
+ *
+ * @brief Start at the fast rate with no track.
+ *
+ * @param  rc   controller
+ * @param  imu  IMU motion hook, or NULL
+ *
+ * @return none
+ */
+void rate_ctrl_init(rate_ctrl_t *rc, rate_imu_hook_t imu)
+{
+    rc->x = rc->y = 0.0f;
+    rc->vx = rc->vy = 0.0f;
+    rc->last_ms = 0;
+    rc->interval_ms = RATE_FAST_MS;
+    rc->init = 0;
+    rc->still = 0;
+    rc->jump = 0;
+    rc->imu = imu;
+}
+
+float rate_ctrl_speed(const rate_ctrl_t *rc)
+{
+    return sqrtf(rc->vx * rc->vx + rc->vy * rc->vy);
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn rate_ctrl_update()
+ *
+ * @brief Update the tracker with the latest fix and return the interval to wait before the next one. Motion (from the IMU or from the tracked
+ *        speed, or a fix far from the prediction) selects the fast rate at once; only after RATE_STILL_FIXES slow fixes in a row does the interval double, up to RATE_SLOW_MS.
+ *
+ * @param  rc      controller
+ * @param  pos     new fix, or NULL if the last attempt gave none (the interval is then kept)
+ * @param  now_ms  current time, in milliseconds
+ *
+ * @return interval until the next fix, in milliseconds
+ */
+uint32_t rate_ctrl_update(rate_ctrl_t *rc, const Position *pos, uint32_t now_ms)
+{
+    int imu = rc->imu ? rc->imu() : -1;
+    int moving;
+
+    if (pos)
+    {
+        if (!rc->init)
+        {
+            rc->x = (float)pos->x;
+            rc->y = (float)pos->y;
+            rc->vx = rc->vy = 0.0f;
+            rc->init = 1;
+        }
+        else
+        {
+            float dt = (now_ms - rc->last_ms) / 1000.0f;
+            float h, px, py, rx, ry;
+
+            if (dt < 0.001f)
+                dt = 0.001f;
+            h = (dt < RATE_PREDICT_MAX_S) ? dt : RATE_PREDICT_MAX_S;
+            px = rc->x + rc->vx * h;
+            py = rc->y + rc->vy * h;
+            rx = (float)pos->x - px;
+            ry = (float)pos->y - py;
+            rc->x = px + RATE_ALPHA * rx;
+            rc->y = py + RATE_ALPHA * ry;
+            rc->vx += RATE_BETA * rx / dt;
+            rc->vy += RATE_BETA * ry / dt;
+            rc->jump = (rx * rx + ry * ry > RATE_MOVE_M * RATE_MOVE_M);
+        }
+        rc->last_ms = now_ms;
+    }
+    else if (imu < 0)
+    {
+        return rc->interval_ms;
+    }
+
+    moving = (imu > 0) || (imu < 0 && (rc->jump || rate_ctrl_speed(rc) > RATE_MOVING_MPS));
+    if (moving)
+    {
+        rc->still = 0;
+        rc->interval_ms = RATE_FAST_MS;
+    }
+    else if (++rc->still >= RATE_STILL_FIXES)
+    {
+        rc->still = RATE_STILL_FIXES;
+        rc->interval_ms *= 2;
+        if (rc->interval_ms > RATE_SLOW_MS)
+            rc->interval_ms = RATE_SLOW_MS;
+    }
+    return rc->interval_ms;
+}
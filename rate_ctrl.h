@@ -0,0 +1,51 @@
+/*! ----------------------------------------------------------------------------
+ *  @file    rate_ctrl.h
+ *  @brief   Motion-driven ranging rate for tags
+ *
+ *           An alpha-beta tracker on the tag's fixes gives its velocity; a moving tag ranges every RATE_FAST_MS, a stationary one backs off step
+ *           by step to a RATE_SLOW_MS heartbeat. An optional IMU hook can report motion before the fixes show it.
+ */
+#ifndef __RATE_CTRL_H__
+#define __RATE_CTRL_H__
+
+#include <stdint.h>
+#include "trilateration.h"
+
+/* Interval between fixes while moving and longest interval while stationary, in milliseconds. */
+#define RATE_FAST_MS 100
+#define RATE_SLOW_MS 5000
+
+/* Speed above which the tag is moving, in m/s. It must stay above the velocity noise of the tracker (position noise x beta / interval). */
+#define RATE_MOVING_MPS 0.5f
+/* Number of consecutive slow fixes before backing off; the interval then doubles at each fix. */
+#define RATE_STILL_FIXES 5
+/* A fix further than this from the tracker's prediction, in metres, also means moving: at the slow rate one fix is too little for the velocity
+ * to build up. It must stay above the position noise. */
+#define RATE_MOVE_M 0.5f
+/* The velocity is not extrapolated further than this, in seconds, at slow rates. */
+#define RATE_PREDICT_MAX_S 1.0f
+
+/* Alpha-beta tracker gains. */
+#define RATE_ALPHA 0.5f
+#define RATE_BETA  0.1f
+
+/* IMU motion hook: returns 1 if moving, 0 if still, -1 if it cannot tell. */
+typedef int (*rate_imu_hook_t)(void);
+
+typedef struct
+{
+    float x, y;           /* Tracked position, metres. */
+    float vx, vy;         /* Tracked velocity, m/s. */
+    uint32_t last_ms;     /* Time of the last fix. */
+    uint32_t interval_ms; /* Current interval between fixes. */
+    uint8_t init;         /* Tracker seeded. */
+    uint8_t still;        /* Consecutive fixes below RATE_MOVING_MPS. */
+    uint8_t jump;         /* Last fix was further than RATE_MOVE_M from the prediction. */
+    rate_imu_hook_t imu;  /* NULL if no IMU. */
+} rate_ctrl_t;
+
+void rate_ctrl_init(rate_ctrl_t *rc, rate_imu_hook_t imu);
+uint32_t rate_ctrl_update(rate_ctrl_t *rc, const Position *pos, uint32_t now_ms);
+float rate_ctrl_speed(const rate_ctrl_t *rc);
+
+#endif
@@ -0,0 +1,169 @@
+#include <deca_device_api.h>
+#include <shared_defines.h>
+#include "reply_tune.h"
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn reply_tune_init()
+ *
+ * @brief Start tuning from the given delay, with an empty history.
+ *
+ * @param  rt       tuner
+ * @param  dly_uus  starting response delay, in UWB microseconds
+ * @param  ofs_uus  shift of the highest delay for the PHY profile in use, 0 for the standard one
+ * @param  shr_uus  air time of the response's preamble and SFD (phy_shr_us()), sent before the RMARKER the delay is set for
+ *
+ * @return none
+ */
+void reply_tune_init(reply_tune_t *rt, uint16_t dly_uus, int16_t ofs_uus, uint16_t shr_uus)
+{
+    int32_t lo = REPLY_TUNE_MIN_TA_UUS + shr_uus, hi = REPLY_TUNE_MAX_UUS + ofs_uus;
+    int i;
+
+    for (i = 0; i < REPLY_TUNE_BINS; i++)
+        rt->hist[i] = 0;
+    rt->n = 0;
+    rt->late = 0;
+    rt->total = 0;
+    rt->total_late = 0;
+    rt->ofs_uus = ofs_uus;
+    rt->shr_uus = shr_uus;
+    rt->dly_uus = (uint16_t)((dly_uus < lo) ? lo : (dly_uus > hi) ? hi : dly_uus);
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn reply_tune_update()
+ *
+ * @brief End of a window: move the delay towards the turnaround quantile plus the response SHR and the margin, by at most REPLY_TUNE_STEP_UUS.
+ *        The TX has to start the SHR before the RMARKER time the delay sets. A window with a late
+ *        TX never lowers it. The histogram is halved so that older windows count less.
+ *
+ * @param  rt  tuner
+ *
+ * @return none
+ */
+static void reply_tune_update(reply_tune_t *rt)
+{
+    uint32_t sum, need, acc;
+    int32_t target;
+    int i;
+
+    sum = 0;
+    for (i = 0; i < REPLY_TUNE_BINS; i++)
+        sum += rt->hist[i];
+
+    if (sum > 0)
+    {
+        need = (sum * REPLY_TUNE_QUANT_PERMIL + 999) / 1000;
+        acc = 0;
+        for (i = 0; i < REPLY_TUNE_BINS - 1; i++)
+        {
+            acc += rt->hist[i];
+            if (acc >= need)
+                break;
+        }
+        /* Upper edge of the quantile's bin. */
+        target = (i + 1) * REPLY_TUNE_BIN_UUS + rt->shr_uus + REPLY_TUNE_MARGIN_UUS;
+
+        if (target > rt->dly_uus + REPLY_TUNE_STEP_UUS)
+            target = rt->dly_uus + REPLY_TUNE_STEP_UUS;
+        else if (target < rt->dly_uus - REPLY_TUNE_STEP_UUS)
+            target = rt->dly_uus - REPLY_TUNE_STEP_UUS;
+        if (rt->late && target < rt->dly_uus)
+            target = rt->dly_uus;
+
+        if (target < REPLY_TUNE_MIN_TA_UUS + rt->shr_uus)
+            target = REPLY_TUNE_MIN_TA_UUS + rt->shr_uus;
+        else if (target > REPLY_TUNE_MAX_UUS + rt->ofs_uus)
+            target = REPLY_TUNE_MAX_UUS + rt->ofs_uus;
+        rt->dly_uus = (uint16_t)target;
+    }
+
+    for (i = 0; i < REPLY_TUNE_BINS; i++)
+        rt->hist[i] >>= 1;
+    rt->n = 0;
+    rt->late = 0;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn reply_tune_tx()
+ *
+ * @brief Account for one exchange. The turnaround runs from the poll RX time-stamp to the system time read right after dwt_starttx(),
+ *        before anything else is done, so that the work done once the response is on its way does not count. A late TX raises the delay by
+ *        REPLY_TUNE_STEP_UUS at once.
+ *
+ * @param  rt             tuner
+ * @param  poll_rx_ts     poll RX time-stamp
+ * @param  tx_start_hi32  dwt_readsystimestamphi32() read right after dwt_starttx()
+ * @param  late           non-zero if dwt_starttx() failed
+ *
+ * @return 1 if rt->dly_uus changed, 0 otherwise
+ */
+int reply_tune_tx(reply_tune_t *rt, uint64_t poll_rx_ts, uint32_t tx_start_hi32, int late)
+{
+    uint16_t old = rt->dly_uus;
+
+    rt->total++;
+    rt->n++;
+    if (late)
+    {
+        rt->total_late++;
+        rt->late++;
+        if (rt->dly_uus + REPLY_TUNE_STEP_UUS <= REPLY_TUNE_MAX_UUS + rt->ofs_uus)
+            rt->dly_uus += REPLY_TUNE_STEP_UUS;
+        else
+            rt->dly_uus = REPLY_TUNE_MAX_UUS + rt->ofs_uus;
+    }
+    else
+    {
+        /* System time high 32 bits count in units of 256 device time units. */
+        uint32_t ta = tx_start_hi32 - (uint32_t)(poll_rx_ts >> 8);
+        uint32_t bin = (uint32_t)(((uint64_t)ta << 8) / UUS_TO_DWT_TIME) / REPLY_TUNE_BIN_UUS;
+
+        if (bin >= REPLY_TUNE_BINS)
+            bin = REPLY_TUNE_BINS - 1;
+        if (rt->hist[bin] < 0xFFFF)
+            rt->hist[bin]++;
+    }
+
+    if (rt->n >= REPLY_TUNE_WINDOW)
+        reply_tune_update(rt);
+
+    return rt->dly_uus != old;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn reply_tune_window()
+ *
+ * @brief Initiator side: RX after TX delay and RX timeout for a responder using the given response delay. The window is the one used with the
+ *        fixed delay (opened lead_uus before the response, timeout_uus long), widened by REPLY_TUNE_STEP_UUS on each side so that it still
+ *        catches the response after the responder's next change. A delay of 0 (not known yet, or lost) gives a window covering the whole
+ *        range, from REPLY_TUNE_MIN_TA_UUS, below the lowest delay of any profile, to REPLY_TUNE_MAX_UUS shifted by ofs_uus.
+ *
+ * @param  reply_dly_uus  responder's response delay, 0 if unknown
+ * @param  lead_uus       response delay minus the RX after TX delay used with a fixed response delay
+ * @param  timeout_uus    RX timeout used with a fixed response delay
+ * @param  ofs_uus        shift of the highest delay for the PHY profile in use, 0 for the standard one
+ * @param  rx_dly_uus     output, value for dwt_setrxaftertxdelay()
+ * @param  rx_to_uus      output, value for dwt_setrxtimeout()
+ *
+ * @return none
+ */
+void reply_tune_window(uint16_t reply_dly_uus, uint16_t lead_uus, uint16_t timeout_uus, int16_t ofs_uus, uint32_t *rx_dly_uus, uint32_t *rx_to_uus)
+{
+    int32_t lo, hi;
+
+    if (reply_dly_uus == 0)
+    {
+        lo = REPLY_TUNE_MIN_TA_UUS - lead_uus - REPLY_TUNE_STEP_UUS;
+        hi = REPLY_TUNE_MAX_UUS + ofs_uus - lead_uus + timeout_uus + REPLY_TUNE_STEP_UUS;
+    }
+    else
+    {
+        lo = reply_dly_uus - lead_uus - REPLY_TUNE_STEP_UUS;
+        hi = reply_dly_uus - lead_uus + timeout_uus + REPLY_TUNE_STEP_UUS;
+    }
+    if (lo < 0)
+        lo = 0;
+    *rx_dly_uus = (uint32_t)lo;
+    *rx_to_uus = (uint32_t)(hi - lo);
+}
@@ -0,0 +1,48 @@
+/*! ----------------------------------------------------------------------------
+ *  @file    reply_tune.h
+ *  @brief   Response delay tuning for SS-TWR responders and the matching RX window on the initiator
+ *
+ *           The responder keeps a histogram of its turnaround (poll RX to delayed TX start) and counts its late TX. At the end of each window of
+ *           REPLY_TUNE_WINDOW exchanges the delay is moved towards the REPLY_TUNE_QUANT_PERMIL quantile of the turnaround plus the response's
+ *           synchronisation header (SHR) and a margin: the delay sets the RMARKER time, and the SHR is sent before it. A late TX raises it at
+ *           once. The delay is carried in the response so that the initiator can open its RX window around it; it changes by at most
+ *           REPLY_TUNE_STEP_UUS at a time, which the initiator's window always covers. The lowest delay is REPLY_TUNE_MIN_TA_UUS over the SHR of
+ *           the profile in use; the highest is for the standard PHY profile and moves with another one (phy_profile.h) by the given offset, the
+ *           difference of the profiles' response delays.
+ */
+#ifndef __REPLY_TUNE_H__
+#define __REPLY_TUNE_H__
+
+#include <stdint.h>
+
+/* Range of the response delay, in UWB microseconds: the shortest turnaround covered, to which the SHR is added, and the longest delay. Then
+ * the margin kept over the turnaround quantile and the SHR. */
+#define REPLY_TUNE_MIN_TA_UUS 160
+#define REPLY_TUNE_MAX_UUS    650
+#define REPLY_TUNE_MARGIN_UUS 40
+/* Largest change of the delay at a time, up or down. */
+#define REPLY_TUNE_STEP_UUS   20
+
+/* Exchanges per tuning window, turnaround histogram bin width (UWB microseconds) and number of bins, and the quantile of the turnaround the
+ * delay must cover, in thousandths. */
+#define REPLY_TUNE_WINDOW       256
+#define REPLY_TUNE_BIN_UUS      8
+#define REPLY_TUNE_BINS         80
+#define REPLY_TUNE_QUANT_PERMIL 999
+
+typedef struct
+{
+    uint16_t dly_uus;                 /* Response delay in use. */
+    uint16_t hist[REPLY_TUNE_BINS];   /* Turnaround histogram, halved at the end of each window. */
+    uint16_t n;                       /* Exchanges in the current window. */
+    uint16_t late;                    /* Late TX in the current window. */
+    int16_t ofs_uus;                  /* Shift of the highest delay, PHY_REPLY_OFS_UUS() of the PHY profile in use. */
+    uint16_t shr_uus;                 /* Response SHR air time, added to the turnaround. */
+    uint32_t total, total_late;       /* Exchanges and late TX since reply_tune_init(). */
+} reply_tune_t;
+
+void reply_tune_init(reply_tune_t *rt, uint16_t dly_uus, int16_t ofs_uus, uint16_t shr_uus);
+int reply_tune_tx(reply_tune_t *rt, uint64_t poll_rx_ts, uint32_t tx_start_hi32, int late);
+void reply_tune_window(uint16_t reply_dly_uus, uint16_t lead_uus, uint16_t timeout_uus, int16_t ofs_uus, uint32_t *rx_dly_uus, uint32_t *rx_to_uus);
+
+#endif
@@ -0,0 +1,151 @@
+#include "report_agg.h"
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn report_agg_init()
+ *
+ * @brief Set up the frame header for reports sent from src to dst, with no record. The buffer size sets the number of records per frame:
+ *        REPORT_AGG_FRAME_MAX for a frame sent as it is, larger for a frame sent with bulk_xfer.c.
+ *
+ * @param  a           aggregator
+ * @param  buf         frame buffer
+ * @param  size        size of buf, checksum included
+ * @param  dst         short address of the gateway
+ * @param  src         short address of the sender
+ * @param  max_age_ms  age of the oldest record at which the frame is sent even if not full, REPORT_AGG_MAX_AGE_MS for a standard frame
+ *
+ * @return none
+ */
+void report_agg_init(report_agg_t *a, uint8_t *buf, uint16_t size, uint16_t dst, uint16_t src, uint32_t max_age_ms)
+{
+    a->frame = buf;
+    a->max = REPORT_AGG_RECS(size);
+    a->frame[0] = 0x41; /* Data frame, 16-bit addressing. */
+    a->frame[1] = 0x88;
+    a->frame[2] = 0;
+    a->frame[3] = 0xCA; /* PAN ID 0xDECA. */
+    a->frame[4] = 0xDE;
+    a->frame[5] = (uint8_t)dst;
+    a->frame[6] = (uint8_t)(dst >> 8);
+    a->frame[7] = (uint8_t)src;
+    a->frame[8] = (uint8_t)(src >> 8);
+    a->frame[9] = REPORT_AGG_FCODE;
+    a->frame[10] = 0;
+    a->n = 0;
+    a->sn = 0;
+    a->first_ms = 0;
+    a->max_age_ms = max_age_ms;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn report_agg_add()
+ *
+ * @brief Append a position to the next frame. Every position is kept, several of the same tag in the order they were added, each with its
+ *        report sequence number, so that the gateway gets the whole track. A full frame must be taken with report_agg_take() before anything
+ *        else is added.
+ *
+ * @param  a       aggregator
+ * @param  r       position report
+ * @param  now_ms  current time in milliseconds
+ *
+ * @return 1 if the frame is full, 0 otherwise
+ */
+int report_agg_add(report_agg_t *a, const report_rec_t *r, uint32_t now_ms)
+{
+    uint8_t *p;
+
+    if (a->n >= a->max)
+        return 1;
+    if (a->n == 0)
+        a->first_ms = now_ms;
+
+    p = &a->frame[REPORT_AGG_HDR_LEN + a->n++ * REPORT_AGG_REC_LEN];
+    p[0] = (uint8_t)r->id;
+    p[1] = (uint8_t)(r->id >> 8);
+    p[2] = r->seq;
+    p[3] = r->quality;
+    p[4] = (uint8_t)r->x_cm;
+    p[5] = (uint8_t)((uint16_t)r->x_cm >> 8);
+    p[6] = (uint8_t)r->y_cm;
+    p[7] = (uint8_t)((uint16_t)r->y_cm >> 8);
+    p[8] = (uint8_t)r->z_cm;
+    p[9] = (uint8_t)((uint16_t)r->z_cm >> 8);
+
+    return a->n >= a->max;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn report_agg_due()
+ *
+ * @brief Tell whether the frame should be sent now: it is full, or its oldest record is max_age_ms old.
+ *
+ * @param  a       aggregator
+ * @param  now_ms  current time in milliseconds
+ *
+ * @return 1 if the frame should be sent, 0 otherwise
+ */
+int report_agg_due(const report_agg_t *a, uint32_t now_ms)
+{
+    if (a->n == 0)
+        return 0;
+    return (a->n >= a->max) || (now_ms - a->first_ms >= a->max_age_ms);
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn report_agg_take()
+ *
+ * @brief Complete the frame for sending and start a new one. a->frame stays valid until the next report_agg_add().
+ *
+ * @param  a  aggregator
+ *
+ * @return frame length including the checksum, for dwt_writetxdata() and dwt_writetxfctrl(), 0 if there is nothing to send
+ */
+uint16_t report_agg_take(report_agg_t *a)
+{
+    uint16_t len;
+
+    if (a->n == 0)
+        return 0;
+    a->frame[2] = a->sn++;
+    a->frame[10] = a->n;
+    len = REPORT_AGG_HDR_LEN + a->n * REPORT_AGG_REC_LEN + 2;
+    a->n = 0;
+    return len;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn report_agg_unpack()
+ *
+ * @brief Gateway side: extract the records of a received aggregated report frame.
+ *
+ * @param  frame  received frame
+ * @param  len    frame length including the checksum
+ * @param  recs   output, records
+ * @param  max    size of recs
+ *
+ * @return number of records written to recs, -1 if the frame is not an aggregated report or is malformed
+ */
+int report_agg_unpack(const uint8_t *frame, uint16_t len, report_rec_t *recs, int max)
+{
+    const uint8_t *p;
+    int n, i;
+
+    if (len < REPORT_AGG_HDR_LEN + 2 || frame[0] != 0x41 || frame[9] != REPORT_AGG_FCODE)
+        return -1;
+    n = frame[10];
+    if (len != REPORT_AGG_HDR_LEN + n * REPORT_AGG_REC_LEN + 2)
+        return -1;
+    if (n > max)
+        n = max;
+
+    for (i = 0; i < n; i++)
+    {
+        p = &frame[REPORT_AGG_HDR_LEN + i * REPORT_AGG_REC_LEN];
+        recs[i].id = p[0] | (p[1] << 8);
+        recs[i].seq = p[2];
+        recs[i].quality = p[3];
+        recs[i].x_cm = (int16_t)(p[4] | (p[5] << 8));
+        recs[i].y_cm = (int16_t)(p[6] | (p[7] << 8));
+        recs[i].z_cm = (int16_t)(p[8] | (p[9] << 8));
+    }
+    return n;
+}
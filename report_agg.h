@@ -0,0 +1,63 @@
+/*! ----------------------------------------------------------------------------
+ *  @file    report_agg.h
+ *  @brief   Position reports of many tags packed into one UWB data frame
+ *
+ *           An anchor collects the positions it computes and sends them to the gateway together, in one IEEE 802.15.4 data frame with function
+ *           code REPORT_AGG_FCODE, instead of one frame per position. Each record is keyed by the tag's address and numbered by the tag's report
+ *           sequence number; positions of the same tag are appended, not merged. A report larger than a standard frame is sent whole as the payload of a
+ *           bulk transfer (bulk_xfer.c). The gateway unpacks the frame with report_agg_unpack().
+ *
+ *           Frame: the 10 byte header common to all frames of the examples (frame control, sequence number, PAN ID, destination, source,
+ *           function code), a record count, then REPORT_AGG_REC_LEN bytes per record, little endian:
+ *             - byte 0/1: short address of the tag.
+ *             - byte 2: tag's report sequence number.
+ *             - byte 3: quality, 0 (poor) to 255.
+ *             - byte 4 -> 9: x, y, z in centimetres, signed 16-bit.
+ *           and the 2 byte checksum.
+ */
+#ifndef __REPORT_AGG_H__
+#define __REPORT_AGG_H__
+
+#include <stdint.h>
+
+/* Function code of the aggregated report frame. */
+#define REPORT_AGG_FCODE 0xE2
+
+/* Largest single frame, checksum included, with the standard PHY header. Larger reports are sent with bulk_xfer.c. */
+#define REPORT_AGG_FRAME_MAX 127
+
+#define REPORT_AGG_HDR_LEN 11
+#define REPORT_AGG_REC_LEN 10
+/* Records that fit in a frame of len bytes (at most 255), and in a standard frame. */
+#define REPORT_AGG_RECS(len) ((((len) - REPORT_AGG_HDR_LEN - 2) / REPORT_AGG_REC_LEN) > 255 ? 255 : (((len) - REPORT_AGG_HDR_LEN - 2) / REPORT_AGG_REC_LEN))
+#define REPORT_AGG_MAX_RECS REPORT_AGG_RECS(REPORT_AGG_FRAME_MAX)
+
+/* Oldest a collected position may get before the frame is sent even if it is not full, in milliseconds, for a standard frame. A larger frame
+ * is given a longer age to fill up. */
+#define REPORT_AGG_MAX_AGE_MS 100
+
+typedef struct
+{
+    uint16_t id;      /* Short address of the tag. */
+    uint8_t seq;      /* Tag's report sequence number. */
+    uint8_t quality;  /* 0 (poor) to 255. */
+    int16_t x_cm, y_cm, z_cm;
+} report_rec_t;
+
+typedef struct
+{
+    uint8_t *frame;     /* Frame buffer given to report_agg_init(). */
+    uint8_t max;        /* Records that fit in it. */
+    uint8_t n;          /* Records in the frame. */
+    uint8_t sn;         /* Frame sequence number. */
+    uint32_t first_ms;  /* Time the first record was added. */
+    uint32_t max_age_ms; /* Age of the first record at which the frame is due. */
+} report_agg_t;
+
+void report_agg_init(report_agg_t *a, uint8_t *buf, uint16_t size, uint16_t dst, uint16_t src, uint32_t max_age_ms);
+int report_agg_add(report_agg_t *a, const report_rec_t *r, uint32_t now_ms);
+int report_agg_due(const report_agg_t *a, uint32_t now_ms);
+uint16_t report_agg_take(report_agg_t *a);
+int report_agg_unpack(const uint8_t *frame, uint16_t len, report_rec_t *recs, int max);
+
+#endif
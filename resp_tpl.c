@@ -0,0 +1,65 @@
+#include <deca_device_api.h>
+#include "resp_tpl.h"
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn resp_tpl_load()
+ *
+ * @brief Write the whole frame and the TX frame control, at zero offset in the TX buffer. Call at set-up and after anything that may have
+ *        overwritten the TX buffer (another frame sent, DW IC reset).
+ *
+ * @param  t        template
+ * @param  frame    frame, kept by reference: edit it and call resp_tpl_dirty() for the bytes changed
+ * @param  len      frame length, including the checksum
+ * @param  ranging  1 to set the ranging bit
+ *
+ * @return none
+ */
+void resp_tpl_load(resp_tpl_t *t, uint8_t *frame, uint16_t len, uint8_t ranging)
+{
+    t->frame = frame;
+    t->len = len;
+    t->lo = len;
+    t->hi = 0;
+    dwt_writetxdata(len, frame, 0);
+    dwt_writetxfctrl(len, 0, ranging);
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn resp_tpl_dirty()
+ *
+ * @brief Mark bytes of the frame as changed.
+ *
+ * @param  t    template
+ * @param  ofs  offset of the first byte changed
+ * @param  n    number of bytes changed
+ *
+ * @return none
+ */
+void resp_tpl_dirty(resp_tpl_t *t, uint16_t ofs, uint16_t n)
+{
+    if (ofs < t->lo)
+        t->lo = ofs;
+    if (ofs + n > t->hi)
+        t->hi = ofs + n;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn resp_tpl_flush()
+ *
+ * @brief Write the changed bytes to the TX buffer in one SPI transaction. Unchanged bytes between two changed fields are rewritten with the same
+ *        value, which costs less than a second transaction when the gap is a few bytes.
+ *
+ * @param  t  template
+ *
+ * @return none
+ */
+void resp_tpl_flush(resp_tpl_t *t)
+{
+    if (t->lo < t->hi)
+    {
+        /* dwt_writetxdata() leaves out the last 2 bytes (the checksum) of the length given. */
+        dwt_writetxdata(t->hi - t->lo + 2, &t->frame[t->lo], t->lo);
+    }
+    t->lo = t->len;
+    t->hi = 0;
+}
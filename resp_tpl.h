@@ -0,0 +1,24 @@
+/*! ----------------------------------------------------------------------------
+ *  @file    resp_tpl.h
+ *  @brief   Response frame template kept in the DW IC TX buffer
+ *
+ *           The whole response is written to the TX buffer once; for each exchange only the bytes that changed (sequence number, time-stamps)
+ *           are written back, as one offset write covering the changed range.
+ */
+#ifndef __RESP_TPL_H__
+#define __RESP_TPL_H__
+
+#include <stdint.h>
+
+typedef struct
+{
+    uint8_t *frame;   /* Local copy of the frame, including the 2 checksum bytes. */
+    uint16_t len;     /* Frame length, including the checksum. */
+    uint16_t lo, hi;  /* Changed bytes since the last flush: [lo, hi), empty if lo >= hi. */
+} resp_tpl_t;
+
+void resp_tpl_load(resp_tpl_t *t, uint8_t *frame, uint16_t len, uint8_t ranging);
+void resp_tpl_dirty(resp_tpl_t *t, uint16_t ofs, uint16_t n);
+void resp_tpl_flush(resp_tpl_t *t);
+
+#endif
@@ -0,0 +1,86 @@
+#include "seq_track.h"
+
+void seq_track_init(seq_track_t *t)
+{
+    t->n = 0;
+    t->dup = 0;
+    t->stale = 0;
+}
+
+/* Follow a peer from sn on. */
+static void seq_peer_start(seq_peer_t *p, uint16_t addr, uint8_t sn, uint32_t now_ms)
+{
+    p->addr = addr;
+    p->hi = sn;
+    p->stale = 0;
+    p->mask = 1;
+    p->last_ms = now_ms;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn seq_track_check()
+ *
+ * @brief Classify a frame by its sequence number and record it. Only SEQ_NEW and SEQ_LATE frames should be used; a caller that must not let an
+ *        older value replace a newer one (a distance, a position) uses SEQ_NEW frames only.
+ *
+ * @param  t       tracking table
+ * @param  addr    sender's short address
+ * @param  sn      sequence number of the frame
+ * @param  now_ms  tick count
+ *
+ * @return SEQ_NEW, SEQ_LATE, SEQ_DUP or SEQ_STALE
+ */
+seq_result_e seq_track_check(seq_track_t *t, uint16_t addr, uint8_t sn, uint32_t now_ms)
+{
+    seq_peer_t *p;
+    int8_t diff;
+    int i, old = 0;
+
+    for (i = 0; i < t->n; i++)
+    {
+        if (t->p[i].addr == addr)
+            break;
+        if (now_ms - t->p[i].last_ms > now_ms - t->p[old].last_ms)
+            old = i;
+    }
+    if (i == t->n)
+    {
+        /* New peer. */
+        p = (t->n < SEQ_PEERS) ? &t->p[t->n++] : &t->p[old];
+        seq_peer_start(p, addr, sn, now_ms);
+        return SEQ_NEW;
+    }
+    p = &t->p[i];
+
+    if (now_ms - p->last_ms > SEQ_RESYNC_MS)
+    {
+        seq_peer_start(p, addr, sn, now_ms);
+        return SEQ_NEW;
+    }
+
+    diff = (int8_t)(sn - p->hi);
+    if (diff > 0)
+    {
+        p->mask = (diff < 32) ? (p->mask << diff) | 1 : 1;
+        p->hi = sn;
+        p->stale = 0;
+        p->last_ms = now_ms;
+        return SEQ_NEW;
+    }
+    if (-diff >= SEQ_WINDOW || diff == -128)
+    {
+        t->stale++;
+        if (++p->stale >= SEQ_RESYNC_STALE)
+            seq_peer_start(p, addr, sn, now_ms);
+        return SEQ_STALE;
+    }
+    /* A duplicate or reordered frame is no sign of the peer going on: it does not hold off a resynchronisation. */
+    p->stale = 0;
+    if (p->mask & (1UL << -diff))
+    {
+        t->dup++;
+        return SEQ_DUP;
+    }
+    p->mask |= 1UL << -diff;
+    return SEQ_LATE;
+}
@@ -0,0 +1,55 @@
+/*! ----------------------------------------------------------------------------
+ *  @file    seq_track.h
+ *  @brief   Per-peer sequence number tracking with a sliding replay window
+ *
+ *           Every frame of the examples carries an 8-bit sequence number (byte 2), incremented by its sender for each new frame. For each peer
+ *           the newest number received and a window of the SEQ_WINDOW numbers before it are kept, as a bitmap of those already received. A
+ *           frame newer than the newest moves the window on; an older one inside the window is a reordered frame if its bit is clear and a
+ *           duplicate if it is set; an older one outside the window is stale. Numbers are compared modulo 256 (serial number arithmetic), so a
+ *           frame up to 127 ahead is newer.
+ *
+ *           A peer with no new frame for SEQ_RESYNC_MS, or SEQ_RESYNC_STALE stale frames in a row (it restarted), is followed again from its
+ *           next frame; duplicates and reordered frames do not hold that off, so a peer that restarted near its old number still resynchronises.
+ */
+#ifndef __SEQ_TRACK_H__
+#define __SEQ_TRACK_H__
+
+#include <stdint.h>
+
+/* Peers tracked; with the table full the peer heard least recently is replaced. */
+#define SEQ_PEERS 16
+/* Window behind the newest number, at most 32. */
+#define SEQ_WINDOW 32
+
+#define SEQ_RESYNC_MS    2000
+#define SEQ_RESYNC_STALE 4
+
+typedef enum
+{
+    SEQ_NEW = 0, /* Newer than any before. */
+    SEQ_LATE,    /* Older than the newest, not received before: reordered. */
+    SEQ_DUP,     /* Received before. */
+    SEQ_STALE    /* Older than the window. */
+} seq_result_e;
+
+typedef struct
+{
+    uint16_t addr;    /* Peer short address, as in the frames. */
+    uint8_t hi;       /* Newest number received. */
+    uint8_t stale;    /* Stale frames in a row. */
+    uint32_t mask;    /* Bit i set if number hi - i was received. */
+    uint32_t last_ms; /* Tick count of the last new frame. */
+} seq_peer_t;
+
+typedef struct
+{
+    seq_peer_t p[SEQ_PEERS];
+    uint8_t n;
+    uint32_t dup;     /* Duplicate and stale frames rejected since seq_track_init(). */
+    uint32_t stale;
+} seq_track_t;
+
+void seq_track_init(seq_track_t *t);
+seq_result_e seq_track_check(seq_track_t *t, uint16_t addr, uint8_t sn, uint32_t now_ms);
+
+#endif
@@ -24,6 +24,10 @@
 #include <shared_defines.h>
 #include <shared_functions.h>
 #include <udp_echoclient.h>
+#include "report_agg.h"
+#include "bulk_xfer.h"
+#include "mesh_relay.h"
+#include "seq_track.h"
 
 #if defined(TEST_SIMPLE_RX)
 extern void ethernetif_input(struct netif *netif);
@@ -44,7 +48,7 @@ static dwt_config_t config = {
     9,                /* RX preamble code. Used in RX only. */
     1,                /* 0 to use standard 8 symbol SFD, 1 to use non-standard 8 symbol, 2 for non-standard 16 symbol SFD and 3 for 4z 8 symbol SDF type */
     DWT_BR_6M8,       /* Data rate. */
-    DWT_PHRMODE_STD,  /* PHY header mode. */
+    DWT_PHRMODE_EXT,  /* PHY header mode: extended, for the bulk transfers (standard frames are received as well). See NOTE 15 below. */
     DWT_PHRRATE_STD,  /* PHY header rate. */
     (129 + 8 - 8),    /* SFD timeout (preamble length + 1 + SFD length - PAC size). Used in RX only. */
     DWT_STS_MODE_OFF, /* STS disabled */
@@ -76,6 +80,14 @@ static uint8_t rx_buffer[RX_BUF_LEN];
 /* Hold copy of status register state here for reference so that it can be examined at a debug breakpoint. */
 static uint32_t status_reg = 0;
 
+/* Received frame, up to the extended frame length, and the positions of an aggregated report. See NOTE 14 and 15 below. */
+static uint8_t rx_frame[BULK_FRAME_MAX];
+static report_rec_t agg_recs[REPORT_AGG_RECS(BULK_RX_MAX)];
+/* Bulk transfer being reassembled. */
+static bulk_rx_t bulk;
+/* Report sequence numbers received from each sender. See NOTE 17 below. */
+static seq_track_t report_seq;
+
 /* Delay between frames, in UWB microseconds. See NOTE 1 below. */
 #define POLL_RX_TO_RESP_TX_DLY_UUS 650
 
@@ -83,6 +95,85 @@ static uint32_t status_reg = 0;
  * temperature. These values can be calibrated prior to taking reference measurements. See NOTE 5 below. */
 extern dwt_txconfig_t txconfig_options;
 
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn report_forward()
+ *
+ * @brief Send the positions of an aggregated report to the UDP server, each as the "X:" and "Y:" pair of a single position report.
+ *
+ * @param  recs  records unpacked from the frame
+ * @param  n     number of records
+ *
+ * @return none
+ */
+static void report_forward(const report_rec_t *recs, int n)
+{
+    seq_result_e r;
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        /* A report already forwarded, or older than the window, is dropped. See NOTE 17 below. */
+        r = seq_track_check(&report_seq, recs[i].id, recs[i].seq, portGetTickCnt());
+        if (r == SEQ_DUP || r == SEQ_STALE)
+            continue;
+        snprintf((char *)udp_msg, 10, "X:%.2f", recs[i].x_cm / 100.0);
+        snprintf((char *)&udp_msg[10], 10, "Y:%.2f", recs[i].y_cm / 100.0);
+        test_run_info(udp_msg);
+        udp_echoclient_send(udp_msg);
+        udp_echoclient_send(&udp_msg[10]);
+    }
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn report_frame()
+ *
+ * @brief Read a received frame and extract the positions it carries, as an aggregated report frame, as a complete bulk transfer or as a
+ *        report relayed by the anchors. See NOTE 14, 15 and 16 below.
+ *
+ * @param  frame_len  length of the frame received
+ *
+ * @return number of positions written to agg_recs (0 for a bulk chunk, a diagnostics dump or a relayed copy), -1 for any other frame
+ */
+static int report_frame(uint16_t frame_len)
+{
+    char diag_str[32];
+    const uint8_t *payload;
+    uint16_t plen;
+    int n;
+
+    if (frame_len > sizeof(rx_frame))
+        return -1;
+    dwt_readrxdata(rx_frame, frame_len, 0);
+
+    /* Relayed report: acknowledged here, and unpacked unless already received. */
+    n = mesh_rx(rx_frame, frame_len, portGetTickCnt(), &payload, &plen);
+    if (n == 1)
+    {
+        n = report_agg_unpack(payload, plen, agg_recs, REPORT_AGG_RECS(BULK_RX_MAX));
+        return (n < 0) ? 0 : n;
+    }
+    if (n == 0)
+        return 0;
+
+    n = report_agg_unpack(rx_frame, frame_len, agg_recs, REPORT_AGG_RECS(BULK_RX_MAX));
+    if (n >= 0)
+        return n;
+
+    n = bulk_rx_frame(&bulk, rx_frame, frame_len);
+    if (n <= 0)
+        return n;
+
+    /* A bulk transfer is complete. */
+    if (bulk.type == BULK_TYPE_REPORT)
+    {
+        n = report_agg_unpack(bulk.buf, bulk.len, agg_recs, REPORT_AGG_RECS(BULK_RX_MAX));
+        return (n < 0) ? 0 : n;
+    }
+    snprintf(diag_str, sizeof(diag_str), "DIAG %lu B L%lu", (unsigned long)bulk.len, (unsigned long)bulk.lost);
+    test_run_info((unsigned char *)diag_str);
+    return 0;
+}
+
 /*! ------------------------------------------------------------------------------------------------------------------
  * @fn main()
  *
@@ -145,10 +236,20 @@ int simple_rx(void)
     /* ڵ ACK . (ù ° Ű ACK  ð. 0̹Ƿ a.s.a.p) */
     //dwt_enableautoack(0, 1);
     udp_echoclient_connect();
+    bulk_rx_init(&bulk);
+    /* Root of the anchors' relay tree. See NOTE 16 below. */
+    {
+        mesh_cfg_t mesh_cfg = { SHORT_ADDR, MESH_NO_PARENT, 0 };
+        mesh_init(&mesh_cfg);
+    }
+    seq_track_init(&report_seq);
     /* Loop forever responding to ranging requests. */
     while (1)
     {
-        dwt_configureframefilter(DWT_FF_ENABLE_802_15_4, DWT_FF_MAC_LE2_EN); //  ͸   (802.15.4 , LE2_PEND ּҰ source addr ġ )
+        int n_rec = -1;
+
+        /* Data frames are let through for the aggregated reports. See NOTE 14 below. */
+        dwt_configureframefilter(DWT_FF_ENABLE_802_15_4, DWT_FF_MAC_LE2_EN | DWT_FF_DATA_EN); //  ͸   (802.15.4 , LE2_PEND ּҰ source addr ġ )
         dwt_configure_le_address(SRC_ADDR, LE2);                             //
         memset(rx_buffer, 0, sizeof(rx_buffer));
 
@@ -161,12 +262,20 @@ int simple_rx(void)
         if (status_reg & DWT_INT_RXFCG_BIT_MASK)
         {
             /* Clear good RX frame event in the DW IC status register. */
+            uint16_t frame_len;
+
             dwt_writesysstatuslo(DWT_INT_RXFCG_BIT_MASK);
 
-            dwt_readrxdata(udp_msg, 20, 12);
+            /* Aggregated reports and bulk transfers are unpacked, any other frame carries a single position as text at offset 12.
+             * See NOTE 14 and 15 below. */
+            frame_len = dwt_getframelength();
+            n_rec = report_frame(frame_len);
+            if (n_rec < 0)
+                dwt_readrxdata(udp_msg, 20, 12);
             //dwt_readrxdata(&udp_msg[10], 10, 22);
         }
-        test_run_info(udp_msg);
+        if (n_rec < 0)
+            test_run_info(udp_msg);
 
 		ethernetif_input(&gnetif);
 
@@ -175,8 +284,15 @@ int simple_rx(void)
 		/* Handle timeouts */
 		sys_check_timeouts();
 
-		udp_echoclient_send(udp_msg);
-		udp_echoclient_send(&udp_msg[10]);
+		if (n_rec >= 0)
+		{
+			report_forward(agg_recs, n_rec);
+		}
+		else
+		{
+			udp_echoclient_send(udp_msg);
+			udp_echoclient_send(&udp_msg[10]);
+		}
     }
 }
 #endif
@@ -253,4 +369,24 @@ int simple_rx(void)
  *     thereafter.
  * 13. Desired configuration by user may be different to the current programmed configuration. dwt_configure is called to set desired
  *     configuration.
+ * 14. Besides the single position text frames, the gateway accepts the aggregated report frames built by report_agg.c (function code
+ *     REPORT_AGG_FCODE), which carry the positions of up to REPORT_AGG_MAX_RECS tags each: tag address, report sequence number, quality and
+ *     x, y, z in centimetres. Every frame is read whole; report_agg_unpack() recognises the aggregated ones and report_forward() sends each of
+ *     their positions to the UDP server as the same "X:" / "Y:" datagram pair as a single report, so the server side is unchanged. Frames that
+ *     are not aggregated reports are handled as before. The UWB uplink then carries one frame per anchor and report period instead of one per
+ *     position.
+ * 15. The gateway runs with the extended PHY header (DWT_PHRMODE_EXT), whose length field reaches 1023 bytes; standard frames, whose extra
+ *     length bits are 0, are received unchanged, so the senders only switch to the extended header for their bulk transfers
+ *     (bulk_xfer.c). rx_frame is sized for the longest extended frame. bulk_rx_frame() reassembles the chunks of a transfer in sequence number
+ *     order into bulk.buf (up to BULK_RX_MAX bytes) and drops the transfer if a chunk is missing. A complete BULK_TYPE_REPORT transfer is an
+ *     aggregated report of up to 99 positions, forwarded like a single frame one; a BULK_TYPE_DIAG transfer (a CIR dump) is only reported
+ *     on the LCD with its size and the number of transfers lost so far, as the UDP server only takes positions.
+ * 16. The gateway is the root of the anchors' relay tree (mesh_relay.c, REPORT_MESH in the trilateration responder): anchors out of its range
+ *     send their aggregated reports over other anchors, one hop per TDMA slot. A relayed frame addressed to the gateway is acknowledged at
+ *     once and its payload, the original report frame, is forwarded like a direct one; a copy sent again after a lost acknowledgement is
+ *     acknowledged but not forwarded twice. The acknowledgements carry the gateway's tick count, the time base of every anchor's slots.
+ * 17. Each position record carries its sender's report sequence number. The gateway tracks it for each sender (seq_track.c) with a window of
+ *     the last SEQ_WINDOW numbers and forwards a record only once: a report received twice, over two paths or in a frame sent again, or one
+ *     older than the window is dropped. A report received out of order but within the window is still forwarded, as every position is
+ *     distinct.
  ****************************************************************************************************************************************************/
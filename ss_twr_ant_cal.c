@@ -0,0 +1,309 @@
+/*! ----------------------------------------------------------------------------
+ *  @file    ss_twr_ant_cal.c
+ *  @brief   Antenna delay calibration using SS TWR
+ *
+ *           This application runs on a device placed at known distances from the anchors. It runs a burst of SS TWR exchanges with every anchor,
+ *           feeds the range errors to the least squares solver in ant_cal.c, applies the resulting antenna delay to itself and reports the
+ *           corrections found for the anchors. The anchors are the usual SS TWR responders (ss_twr_responder_ANCHOR.c).
+ *
+ * @attention
+ *
+ * Copyright 2015 - 2021 (c) Decawave Ltd, Dublin, Ireland.
+ *
+ * All rights reserved.
+ *
+ * @author Decawave
+ */
+
+#include "deca_probe_interface.h"
+#include <config_options.h>
+#include <deca_device_api.h>
+#include <deca_spi.h>
+#include <example_selection.h>
+#include <port.h>
+#include <shared_defines.h>
+#include <shared_functions.h>
+#include "ant_cal.h"
+#include "clock_track.h"
+#include "reply_tune.h"
+
+#if defined(TEST_SS_TWR_ANT_CAL)
+
+extern void test_run_info(unsigned char *data);
+
+/* Example application name */
+#define APP_NAME "SS TWR ANT CAL v1.0"
+
+/* Default communication configuration. Must match the anchors. */
+static dwt_config_t config = {
+    5,                /* Channel number. */
+    DWT_PLEN_128,     /* Preamble length. Used in TX only. */
+    DWT_PAC8,         /* Preamble acquisition chunk size. Used in RX only. */
+    9,                /* TX preamble code. Used in TX only. */
+    9,                /* RX preamble code. Used in RX only. */
+    1,                /* 0 to use standard 8 symbol SFD, 1 to use non-standard 8 symbol, 2 for non-standard 16 symbol SFD and 3 for 4z 8 symbol SDF type */
+    DWT_BR_6M8,       /* Data rate. */
+    DWT_PHRMODE_STD,  /* PHY header mode. */
+    DWT_PHRRATE_STD,  /* PHY header rate. */
+    (129 + 8 - 8),    /* SFD timeout (preamble length + 1 + SFD length - PAC size). Used in RX only. */
+    DWT_STS_MODE_OFF, /* STS disabled */
+    DWT_STS_LEN_64,   /* STS length see allowed values in Enum dwt_sts_lengths_e */
+    DWT_PDOA_M0       /* PDOA mode off */
+};
+
+/* Antenna delay programmed in every device while calibrating. The corrections found are relative to this value. */
+#define TX_ANT_DLY 16385
+#define RX_ANT_DLY 16385
+
+/* Number of exchanges per anchor and delay between them, in milliseconds. */
+#define CAL_BURST_LEN   200
+#define CAL_EXCHANGE_MS 5
+
+/* Index of the reference anchor: one already calibrated and running with its calibrated delay, so its correction is held at 0. -1 for none.
+ * See NOTE 2 below. */
+#define CAL_REF_ANCHOR 0
+/* Weight of the reference, in range samples: far above any burst so that it does not move. */
+#define CAL_REF_WEIGHT 1e6
+
+/* Uncomment to write this device's calibrated delay to OTP. It needs a reference anchor. See NOTE 3 below. */
+//#define CAL_WRITE_OTP
+
+#if defined(CAL_WRITE_OTP) && (CAL_REF_ANCHOR < 0)
+#error "CAL_WRITE_OTP needs a reference anchor (CAL_REF_ANCHOR): without one the delay found is not determined"
+#endif
+
+#define CAL_NUM_ANCHORS 3
+
+/* Frames used in the ranging process, same as the SS TWR tag. The response's source, "WA" here, is set to the address of the anchor polled. */
+static uint8_t tx_poll_msg[CAL_NUM_ANCHORS][12] = {
+    { 0x63, 0x88, 1, 0xCA, 0xDE, 'A', '1', 'V', 'E', 0xE0, 0, 0 },
+    { 0x63, 0x88, 1, 0xCA, 0xDE, 'A', '2', 'V', 'E', 0xE0, 0, 0 },
+    { 0x63, 0x88, 1, 0xCA, 0xDE, 'A', '3', 'V', 'E', 0xE0, 0, 0 },
+};
+static uint8_t rx_resp_msg[] = { 0x41, 0x88, 0, 0xCA, 0xDE, 'V', 'E', 'W', 'A', 0xE1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+
+/* Measured (tape) distance from this device to each anchor, in metres. See NOTE 1 below. */
+static const double cal_dist_m[CAL_NUM_ANCHORS] = { 3.00, 3.00, 3.00 };
+
+#define ALL_MSG_COMMON_LEN      10
+#define ALL_MSG_SN_IDX          2
+#define RESP_MSG_POLL_RX_TS_IDX 10
+#define RESP_MSG_RESP_TX_TS_IDX 14
+#define RESP_MSG_REPLY_DLY_IDX  18
+
+#define RX_BUF_LEN 22
+static uint8_t rx_buffer[RX_BUF_LEN];
+
+static uint32_t status_reg = 0;
+
+#define POLL_TX_TO_RESP_RX_DLY_UUS 240
+#define RESP_RX_TIMEOUT_UUS        400
+/* Anchors' fixed response delay, where their tuning starts. The RX window follows the delay each anchor announces. See NOTE 4 below. */
+#define POLL_RX_TO_RESP_TX_DLY_UUS 650
+#define RESP_RX_LEAD_UUS           (POLL_RX_TO_RESP_TX_DLY_UUS - POLL_TX_TO_RESP_RX_DLY_UUS)
+
+/* Response delay last announced by each anchor, 0 if not known. */
+static uint16_t reply_dly[CAL_NUM_ANCHORS];
+
+extern dwt_txconfig_t txconfig_options;
+
+static ant_cal_t cal;
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn range_once()
+ *
+ * @brief Run one SS TWR exchange and return the time of flight in device time units.
+ *
+ * @param  anchor  anchor index
+ * @param  tof_dtu output, time of flight
+ *
+ * @return 0 on success, -1 on timeout or unexpected frame
+ */
+static int range_once(int anchor, double *tof_dtu)
+{
+    uint16_t frame_len;
+    uint32_t rx_dly, rx_to;
+
+    reply_tune_window(reply_dly[anchor], RESP_RX_LEAD_UUS, RESP_RX_TIMEOUT_UUS, 0, &rx_dly, &rx_to);
+    dwt_setrxaftertxdelay(rx_dly);
+    dwt_setrxtimeout(rx_to);
+
+    dwt_writesysstatuslo(DWT_INT_TXFRS_BIT_MASK);
+    dwt_writetxdata(sizeof(tx_poll_msg[anchor]), tx_poll_msg[anchor], 0);
+    dwt_writetxfctrl(sizeof(tx_poll_msg[anchor]), 0, 1);
+    dwt_starttx(DWT_START_TX_IMMEDIATE | DWT_RESPONSE_EXPECTED);
+
+    waitforsysstatus(&status_reg, NULL, (DWT_INT_RXFCG_BIT_MASK | SYS_STATUS_ALL_RX_TO | SYS_STATUS_ALL_RX_ERR), 0);
+    if (!(status_reg & DWT_INT_RXFCG_BIT_MASK))
+    {
+        dwt_writesysstatuslo(SYS_STATUS_ALL_RX_TO | SYS_STATUS_ALL_RX_ERR);
+        /* Lost the anchor's delay: open the whole tuning range. */
+        reply_dly[anchor] = 0;
+        return -1;
+    }
+    dwt_writesysstatuslo(DWT_INT_RXFCG_BIT_MASK);
+
+    frame_len = dwt_getframelength();
+    if (frame_len > sizeof(rx_buffer))
+        return -1;
+    dwt_readrxdata(rx_buffer, frame_len, 0);
+    /* The anchors number their responses and answer from their own address: compare the header without the sequence number, against the
+     * address of the anchor polled. */
+    rx_buffer[ALL_MSG_SN_IDX] = 0;
+    rx_resp_msg[7] = tx_poll_msg[anchor][5];
+    rx_resp_msg[8] = tx_poll_msg[anchor][6];
+    if (memcmp(rx_buffer, rx_resp_msg, ALL_MSG_COMMON_LEN) != 0)
+        return -1;
+
+    {
+        uint32_t poll_tx_ts, resp_rx_ts, poll_rx_ts, resp_tx_ts;
+        int32_t rtd_init, rtd_resp;
+        float clockOffsetRatio;
+
+        poll_tx_ts = dwt_readtxtimestamplo32();
+        resp_rx_ts = dwt_readrxtimestamplo32();
+        clockOffsetRatio = ((float)dwt_readclockoffset()) / (uint32_t)(1 << 26);
+        resp_msg_get_ts(&rx_buffer[RESP_MSG_POLL_RX_TS_IDX], &poll_rx_ts);
+        resp_msg_get_ts(&rx_buffer[RESP_MSG_RESP_TX_TS_IDX], &resp_tx_ts);
+        /* Follow the anchor's response delay; a responder without the field gets the wide window. */
+        if (frame_len >= sizeof(rx_resp_msg))
+            reply_dly[anchor] = rx_buffer[RESP_MSG_REPLY_DLY_IDX] | (rx_buffer[RESP_MSG_REPLY_DLY_IDX + 1] << 8);
+        else
+            reply_dly[anchor] = 0;
+
+        /* Back-to-back exchanges give the clock tracker usable time-stamp pairs. */
+        clockOffsetRatio = clk_track_update((uint16_t)(tx_poll_msg[anchor][5] | (tx_poll_msg[anchor][6] << 8)), clockOffsetRatio,
+                                            get_tx_timestamp_u64(), poll_rx_ts);
+
+        rtd_init = resp_rx_ts - poll_tx_ts;
+        rtd_resp = resp_tx_ts - poll_rx_ts;
+        *tof_dtu = (rtd_init - rtd_resp * (1 - clockOffsetRatio)) / 2.0;
+    }
+    return 0;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn ss_twr_ant_cal()
+ *
+ * @brief Application entry point.
+ *
+ * @param  none
+ *
+ * @return none
+ */
+int ss_twr_ant_cal(void)
+{
+    double corr[CAL_NUM_ANCHORS + 1];
+    int a, i;
+
+    test_run_info((unsigned char *)APP_NAME);
+
+    port_set_dw_ic_spi_fastrate();
+    reset_DWIC();
+    Sleep(2);
+    dwt_probe((struct dwt_probe_s *)&dw3000_probe_interf);
+
+    while (!dwt_checkidlerc()) { };
+    if (dwt_initialise(DWT_DW_INIT) == DWT_ERROR)
+    {
+        test_run_info((unsigned char *)"INIT FAILED     ");
+        while (1) { };
+    }
+    if (dwt_configure(&config))
+    {
+        test_run_info((unsigned char *)"CONFIG FAILED     ");
+        while (1) { };
+    }
+    dwt_configuretxrf(&txconfig_options);
+
+    /* Calibrate from the nominal value, not from a previous calibration. */
+    dwt_setrxantennadelay(RX_ANT_DLY);
+    dwt_settxantennadelay(TX_ANT_DLY);
+
+    dwt_setlnapamode(DWT_LNA_ENABLE | DWT_PA_ENABLE);
+
+    clk_track_init();
+
+    /* Device 0 is this device, device a + 1 is anchor a. See NOTE 2 below. */
+    ant_cal_init(&cal, CAL_NUM_ANCHORS + 1);
+#if CAL_REF_ANCHOR >= 0
+    ant_cal_pin(&cal, CAL_REF_ANCHOR + 1, CAL_REF_WEIGHT);
+#endif
+
+    for (a = 0; a < CAL_NUM_ANCHORS; a++)
+    {
+        double true_tof_dtu = cal_dist_m[a] / SPEED_OF_LIGHT / DWT_TIME_UNITS;
+        int ok = 0;
+
+        for (i = 0; i < CAL_BURST_LEN; i++)
+        {
+            double tof_dtu;
+
+            if (range_once(a, &tof_dtu) == 0)
+            {
+                ant_cal_add(&cal, 0, a + 1, tof_dtu - true_tof_dtu);
+                ok++;
+            }
+            Sleep(CAL_EXCHANGE_MS);
+        }
+        snprintf(dist_str, sizeof(dist_str), "A%d: %d/%d", a + 1, ok, CAL_BURST_LEN);
+        test_run_info((unsigned char *)dist_str);
+    }
+
+    if (ant_cal_solve(&cal, corr) != 0)
+    {
+        test_run_info((unsigned char *)"CAL FAILED      ");
+        while (1) { };
+    }
+
+    {
+        uint16_t ant_dly = (uint16_t)(TX_ANT_DLY + (int)lround(corr[0]));
+
+#if CAL_REF_ANCHOR < 0
+        /* Without a reference only the sums of this device's and each anchor's delays are known: the split shown is arbitrary. */
+        test_run_info((unsigned char *)"NO REF ANCHOR   ");
+#endif
+        dwt_setrxantennadelay(ant_dly);
+        dwt_settxantennadelay(ant_dly);
+        snprintf(dist_str, sizeof(dist_str), "DLY: %u", ant_dly);
+        test_run_info((unsigned char *)dist_str);
+#if defined(CAL_WRITE_OTP)
+        if (ant_cal_store(ant_dly, ant_dly) != 0)
+        {
+            test_run_info((unsigned char *)"OTP WRITE FAILED");
+        }
+#endif
+    }
+
+    /* Corrections for the anchors, to be programmed in each of them. */
+    for (a = 0; a < CAL_NUM_ANCHORS; a++)
+    {
+        snprintf(dist_str, sizeof(dist_str), "A%d: %+ld", a + 1, lround(corr[a + 1]));
+        test_run_info((unsigned char *)dist_str);
+    }
+
+    while (1) { };
+}
+
+#endif
+/*****************************************************************************************************************************************************
+ * NOTES:
+ *
+ * 1. The distances must be measured between the antennas, with the devices in line of sight and away from reflecting surfaces. Any error in them
+ *    goes straight into the calibrated delays (1 cm is about 2 device time units of antenna delay).
+ * 2. With the same delay used for TX and RX, the SS TWR time of flight error of a pair is the sum of the two devices' delay errors. Every pair
+ *    measured here includes this device, so on their own the ranges only give the sum of this device's and each anchor's delay errors: any
+ *    split, this device's delay up by some amount and every anchor's down by the same, fits them equally well. The reference anchor,
+ *    CAL_REF_ANCHOR, fixes the split: it must be a unit already calibrated (e.g. by this example against another reference) and running with
+ *    its calibrated delay, and its correction is pinned at 0 with ant_cal_pin(). Its pair then gives this device's delay, and this device's the
+ *    other anchors'. With CAL_REF_ANCHOR at -1 the solver falls back to sharing each pair's error between the two devices (see ANT_CAL_RIDGE),
+ *    which is arbitrary: the result is only shown, and CAL_WRITE_OTP is refused at build time. The solver in ant_cal.c does not use the DW IC
+ *    driver and can be fed with simulated ranges.
+ * 3. OTP memory can only be written once. ant_cal_store() uses the next free record of ANT_CAL_OTP_SLOTS, and ant_cal_load() returns the last
+ *    valid one, so a device can be re-calibrated a few times. The tag and responder examples call ant_cal_load() at start-up and keep the default
+ *    TX_ANT_DLY/RX_ANT_DLY when no record is found.
+ * 4. The anchors tune their response delay between REPLY_TUNE_MIN_TA_UUS plus the response SHR and REPLY_TUNE_MAX_UUS and announce it in each
+ *    response (NOTE 17 of the anchor example). As on the tag, the RX window for each anchor is opened with reply_tune_window() around the
+ *    delay it announced last, or over the whole tuning range until it is known or after a timeout. The anchors must run the standard PHY
+ *    profile, as config here.
+ ****************************************************************************************************************************************************/
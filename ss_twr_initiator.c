@@ -25,6 +25,7 @@
 #include <port.h>
 #include <shared_defines.h>
 #include <shared_functions.h>
+#include "clock_track.h"
 
 #if defined(TEST_SS_TWR_INITIATOR)
 
@@ -101,10 +102,12 @@ static uint8_t rx_resp_msg[] = { 0x41, 0x88, 0, 0xCA, 0xDE, 'V', 'E', 'W', 'A',
 #define RESP_MSG_TS_LEN         4
 /* Frame sequence number, incremented after each transmission. */
 static uint8_t frame_seq_nb = 0;
+/* Short address of the anchor polled for each value of frame_seq_nb, used to key the clock offset tracking. See NOTE 14 below. */
+static const uint16_t anchor_addr[] = { SRC_A1, SRC_A2, SRC_A3 };
 
 /* Buffer to store received response message.
  * Its size is adjusted to longest frame that this example code is supposed to handle. */
-#define RX_BUF_LEN 20
+#define RX_BUF_LEN 22
 static uint8_t rx_buffer[RX_BUF_LEN];
 
 /* Hold copy of status register state here for reference so that it can be examined at a debug breakpoint. */
@@ -196,6 +199,8 @@ int ss_twr_initiator(void)
      * Note, in real low power applications the LEDs should not be used. */
     dwt_setlnapamode(DWT_LNA_ENABLE | DWT_PA_ENABLE);
 
+    /* Start per-anchor clock offset tracking from scratch. See NOTE 14 below. */
+    clk_track_init();
 
     //int start_time, end_time, result;
     /* Loop forever initiating ranging exchanges. */
@@ -211,16 +216,23 @@ int ss_twr_initiator(void)
             dwt_writesysstatuslo(DWT_INT_TXFRS_BIT_MASK);
             dwt_writetxdata(sizeof(tx_poll_msg1), tx_poll_msg1, 0); /* Zero offset in TX buffer. */
             dwt_writetxfctrl(sizeof(tx_poll_msg1), 0, 1);          /* Zero offset in TX buffer, ranging. */
+            /* The anchor answers from its own address. */
+            rx_resp_msg[7] = tx_poll_msg1[5];
+            rx_resp_msg[8] = tx_poll_msg1[6];
             break;
     	case 1:
             dwt_writesysstatuslo(DWT_INT_TXFRS_BIT_MASK);
             dwt_writetxdata(sizeof(tx_poll_msg2), tx_poll_msg2, 0); /* Zero offset in TX buffer. */
             dwt_writetxfctrl(sizeof(tx_poll_msg2), 0, 1);          /* Zero offset in TX buffer, ranging. */
+            rx_resp_msg[7] = tx_poll_msg2[5];
+            rx_resp_msg[8] = tx_poll_msg2[6];
             break;
     	case 2:
             dwt_writesysstatuslo(DWT_INT_TXFRS_BIT_MASK);
             dwt_writetxdata(sizeof(tx_poll_msg3), tx_poll_msg3, 0); /* Zero offset in TX buffer. */
             dwt_writetxfctrl(sizeof(tx_poll_msg3), 0, 1);          /* Zero offset in TX buffer, ranging. */
+            rx_resp_msg[7] = tx_poll_msg3[5];
+            rx_resp_msg[8] = tx_poll_msg3[6];
             break;
     	default:
     		frame_seq_nb=0;
@@ -245,6 +257,10 @@ int ss_twr_initiator(void)
             if (frame_len <= sizeof(rx_buffer))
             {
                 dwt_readrxdata(rx_buffer, frame_len, 0);
+
+                /* Check that the frame is the expected response from the companion "SS TWR responder" example.
+                 * As the sequence number field of the frame is not relevant, it is cleared to simplify the validation of the frame. */
+                rx_buffer[ALL_MSG_SN_IDX] = 0;
                 if (memcmp(rx_buffer, rx_resp_msg, ALL_MSG_COMMON_LEN) == 0)
                 {
                     uint32_t poll_tx_ts, resp_rx_ts, poll_rx_ts, resp_tx_ts;
@@ -262,6 +278,12 @@ int ss_twr_initiator(void)
                     resp_msg_get_ts(&rx_buffer[RESP_MSG_POLL_RX_TS_IDX], &poll_rx_ts);
                     resp_msg_get_ts(&rx_buffer[RESP_MSG_RESP_TX_TS_IDX], &resp_tx_ts);
 
+                    /* Replace the single noisy reading by the anchor's smoothed clock offset ratio. See NOTE 14 below. */
+                    if (frame_seq_nb < sizeof(anchor_addr) / sizeof(anchor_addr[0]))
+                    {
+                        clockOffsetRatio = clk_track_update(anchor_addr[frame_seq_nb], clockOffsetRatio, get_tx_timestamp_u64(), poll_rx_ts);
+                    }
+
                     /* Compute time of flight and distance, using clock offset ratio to correct for differing local and remote clock rates */
                     rtd_init = resp_rx_ts - poll_tx_ts;
                     rtd_resp = resp_tx_ts - poll_rx_ts;
@@ -470,4 +492,10 @@ void tril_do()
  *     thereafter.
  * 13. Desired configuration by user may be different to the current programmed configuration. dwt_configure is called to set desired
  *     configuration.
+ * 14. The carrier integrator reading of a single short response frame is noisy, and in SS-TWR that noise is multiplied by the whole response delay.
+ *     clk_track_update() (clock_track.c) keeps one smoothed clock offset ratio per anchor, blending the carrier integrator readings with the drift
+ *     measured between the local poll TX time-stamps and the remote poll RX time-stamps of consecutive exchanges. The time-stamp pair is only used
+ *     when two exchanges with the same anchor are between 1 ms and ~67 ms apart (the remote time-stamp is 32 bits), e.g. back-to-back exchanges;
+ *     otherwise only the carrier integrator is filtered. With a stable ratio the responders' POLL_RX_TO_RESP_TX_DLY_UUS can be reduced without adding
+ *     a range bias.
  ****************************************************************************************************************************************************/
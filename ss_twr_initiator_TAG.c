@@ -25,6 +25,21 @@
 #include <port.h>
 #include <shared_defines.h>
 #include <shared_functions.h>
+#include "ant_cal.h"
+#include "clock_track.h"
+#include "range_filter.h"
+#include "nlos.h"
+#include "trilateration.h"
+#include "anchor_select.h"
+#include "rate_ctrl.h"
+#include "dw_sleep.h"
+#include "reply_tune.h"
+#include "phy_profile.h"
+#include "zone.h"
+#include "handover.h"
+#include "rand_access.h"
+#include "join.h"
+#include "range_align.h"
 
 #if defined(TEST_SS_TWR_INITIATOR)
 
@@ -33,29 +48,81 @@ extern void test_run_info(unsigned char *data);
 /* Example application name */
 #define APP_NAME "SS TWR INIT v1.0"
 
-/* Default communication configuration. We use default non-STS DW mode. */
-static dwt_config_t config = {
-    5,                /* Channel number. */
-    DWT_PLEN_128,     /* Preamble length. Used in TX only. */
-    DWT_PAC8,         /* Preamble acquisition chunk size. Used in RX only. */
-    9,                /* TX preamble code. Used in TX only. */
-    9,                /* RX preamble code. Used in RX only. */
-    1,                /* 0 to use standard 8 symbol SFD, 1 to use non-standard 8 symbol, 2 for non-standard 16 symbol SFD and 3 for 4z 8 symbol SDF type */
-    DWT_BR_6M8,       /* Data rate. */
-    DWT_PHRMODE_STD,  /* PHY header mode. */
-    DWT_PHRRATE_STD,  /* PHY header rate. */
-    (129 + 8 - 8),    /* SFD timeout (preamble length + 1 + SFD length - PAC size). Used in RX only. */
-    DWT_STS_MODE_OFF, /* STS disabled */
-    DWT_STS_LEN_64,   /* STS length see allowed values in Enum dwt_sts_lengths_e */
-    DWT_PDOA_M0       /* PDOA mode off */
-};
+/* PHY profile (phy_profile.c): preamble length and data rate, with the delays below to match. The anchors must use the same one.
+ * See NOTE 25 below. */
+#define PHY_PROFILE PHY_PROFILE_STD
+/* Profile in use, set by phy_reconfigure(): the delays below read through it. */
+static const phy_profile_t *phy = &phy_profiles[PHY_PROFILE];
+/* Communication configuration, the profile's: copied by phy_reconfigure() at start-up and on a switch. */
+static dwt_config_t config;
+
+/* Measure the air time of an exchange in each PHY profile at start-up. See NOTE 25 below. */
+//#define PHY_BENCH
+
+/* Zone the tag starts in. See NOTE 26 below. */
+#define TAG_ZONE 0
+static uint8_t tag_zone = TAG_ZONE;
+/* Handover to a neighbouring zone. See NOTE 27 below. */
+static ho_t ho;
 
 /* Inter-ranging delay period, in milliseconds. */
 #define RNG_DELAY_MS 1000
 
+/* Adapt the interval between fixes to the tag's motion instead of the fixed RNG_DELAY_MS. See NOTE 21 below. */
+#define RNG_ADAPTIVE
+/* IMU motion hook (rate_imu_hook_t) if the board has one, NULL otherwise. */
+#define RNG_IMU_HOOK NULL
+
+/* Range all the anchors of a fix in one back-to-back run, each poll sent as soon as the previous response is read. See NOTE 24 below. */
+#define RNG_PIPELINE
+
+/* Put the DW IC into DEEPSLEEP between exchanges and restore its configuration on wake-up. See NOTE 22 below. */
+#define RNG_DUTY_CYCLE
+/* Number of wake-ups between two reports of the wake-up to first poll time. */
+#define WAKE_REPORT_WAKES 100
+
+/* Number of back-to-back exchanges per anchor, reduced to one distance and its variance. See NOTE 15 below. */
+#define RNG_BURST_LEN 8
+
+/* Contend for the channel: listen before each run and add a random backoff to the wait. For a tag without a slot. See NOTE 28 below. */
+#define RNG_RANDOM_ACCESS
+/* Contention slot: one run of exchanges between two waits, at about 1 ms per exchange. */
+#ifdef RNG_PIPELINE
+#define RA_SLOT_MS (SEL_ANCHORS * RNG_BURST_LEN)
+#else
+#define RA_SLOT_MS RNG_BURST_LEN
+#endif
+
+/* Join the network: lease an address and a slot from the coordinator anchor of the zone. See NOTE 29 below. */
+#define TAG_JOIN
+/* Address in the frame templates ("VE"), used until the tag has joined. */
+#define TAG_ADDR 0x4556
+
+/* Bring the ranges of a fix to the time of the newest one, extrapolating or leaving out older ones. See NOTE 31 below. */
+#define RNG_TIME_ALIGN
+
+/* Use the outlier-tolerant position solver. It only differs from the plain one when more than 3 anchors are ranged. See NOTE 17 below. */
+#define TRIL_ROBUST
+
+/* Refine each fix with nonlinear least squares on the range residuals. See NOTE 18 below. */
+#define TRIL_REFINE
+
+/* Height of the tag, in metres, in the same frame as the anchors' z. The slant ranges are projected to the tag's plane before solving (2.5D).
+ * See NOTE 19 below. */
+#define TAG_HEIGHT_M 0.0
+
+/* Number of anchors ranged for each fix, chosen from the anchor table for the best geometry around the last position. The three anchors of
+ * anchor_tab[] are all ranged: the selection needs more anchors than this. See NOTE 20 below. */
+#define SEL_ANCHORS 3
+/* Anchors that did not answer are left out of the selection until this many fixes have passed. */
+#define SEL_RETRY_FIXES 10
+
 /* Default antenna delay values for 64 MHz PRF. See NOTE 2 below. */
 #define TX_ANT_DLY 16385
 #define RX_ANT_DLY 16385
+/* Antenna delays in use: the defaults above, or the calibrated values stored in OTP by the antenna delay calibration example. */
+static uint16_t tx_ant_dly = TX_ANT_DLY;
+static uint16_t rx_ant_dly = RX_ANT_DLY;
 
 /*
 IEEE 802.15.4-2015 standard를 지킨 MAC프레임 설정
@@ -89,12 +156,7 @@ IEEE 802.15.4-2015 standard를 지킨 MAC프레임 설정
 static uint8_t tx_poll_msg1[] = { 0x63, 0x88, 1, 0xCA, 0xDE, 'A', '1', 'V', 'E', 0xE0, 0, 0 }; // 63이므로 MAC
 static uint8_t tx_poll_msg2[] = { 0x63, 0x88, 1, 0xCA, 0xDE, 'A', '2', 'V', 'E', 0xE0, 0, 0 };
 static uint8_t tx_poll_msg3[] = { 0x63, 0x88, 1, 0xCA, 0xDE, 'A', '3', 'V', 'E', 0xE0, 0, 0 };
-static uint8_t rx_resp_msg[] = { 0x41, 0x88, 0, 0xCA, 0xDE, 'V', 'E', 'W', 'A', 0xE1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 }; // 41이므로 Data
-unsigned char arr1[] = {'X',':',0,0,0,0,0,0,0,0,'Y',':',0,0,0,0,0,0,0,0};
-//unsigned char arr2[16] = {'Y',':',0,0,0,0,0,0,0,0};
-//unsigned char result_arr[32] = {'X',':',0,0,0,0,0,0,0,0,'Y',':',0,0,0,0,0,0,0,0};
-
-
+static uint8_t rx_resp_msg[] = { 0x41, 0x88, 0, 0xCA, 0xDE, 'V', 'E', 'W', 'A', 0xE1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 }; // 41이므로 Data
 
 /* Length of the common part of the message (up to and including the function code, see NOTE 3 below). */
 #define ALL_MSG_COMMON_LEN 10
@@ -103,43 +165,121 @@ unsigned char arr1[] = {'X',':',0,0,0,0,0,0,0,0,'Y',':',0,0,0,0,0,0,0,0};
 #define RESP_MSG_POLL_RX_TS_IDX 10
 #define RESP_MSG_RESP_TX_TS_IDX 14
 #define RESP_MSG_TS_LEN         4
+#define RESP_MSG_REPLY_DLY_IDX  18
 /* Frame sequence number, incremented after each transmission. */
 static uint8_t frame_seq_nb = 1;
+/* Short address of the anchor polled for each value of frame_seq_nb, used to key the clock offset tracking. See NOTE 14 below. */
+static const uint16_t anchor_addr[] = { SRC_A1, SRC_A2, SRC_A3 };
+/* Poll frame for each value of frame_seq_nb. */
+static uint8_t *tx_poll_msgs[] = { tx_poll_msg1, tx_poll_msg2, tx_poll_msg3 };
+/* Zone (zone.c) of each anchor. See NOTE 26 below. */
+static const uint8_t anchor_zone[] = { 0, 0, 0 };
+#define NUM_ANCHORS 3
+/* Response delay last announced by each anchor, in UWB microseconds, 0 if not known. See NOTE 23 below. */
+static uint16_t reply_dly[NUM_ANCHORS];
 
 /* Buffer to store received response message.
  * Its size is adjusted to longest frame that this example code is supposed to handle. */
-#define RX_BUF_LEN 20
+#define RX_BUF_LEN 22
 static uint8_t rx_buffer[RX_BUF_LEN];
 
 /* Hold copy of status register state here for reference so that it can be examined at a debug breakpoint. */
 static uint32_t status_reg = 0;
 
-/* Delay between frames, in UWB microseconds. See NOTE 1 below. */
-#define POLL_TX_TO_RESP_RX_DLY_UUS 240
-/* Receive response timeout. See NOTE 5 below. */
-#define RESP_RX_TIMEOUT_UUS 400
+/* Delay between frames, in UWB microseconds, 240 in the standard profile. See NOTE 1 below. */
+#define POLL_TX_TO_RESP_RX_DLY_UUS (phy->resp_rx_dly_uus)
+/* Receive response timeout, 400 in the standard profile. See NOTE 5 below. */
+#define RESP_RX_TIMEOUT_UUS (phy->resp_rx_to_uus)
+/* Response delay of a responder with a fixed delay (its POLL_RX_TO_RESP_TX_DLY_UUS) minus POLL_TX_TO_RESP_RX_DLY_UUS: how long before the
+ * response delay the RX window opens. See NOTE 23 below. */
+#define RESP_RX_LEAD_UUS (phy->reply_dly_uus - POLL_TX_TO_RESP_RX_DLY_UUS)
 
 /* Hold copies of computed time of flight and distance here for reference so that it can be examined at a debug breakpoint. */
 static double tof;
+#ifndef RNG_PIPELINE
 static double distance;
+#endif
 
 /* Values for the PG_DELAY and TX_POWER registers reflect the bandwidth and power of the spectrum at the current
  * temperature. These values can be calibrated prior to taking reference measurements. See NOTE 2 below. */
 extern dwt_txconfig_t txconfig_options;
 
-typedef struct Anchor
-{
-	double x;
-	double y;
-	double distance;
-}Anchor;
 
+int tril_do(void);
+/* x, y, z of each anchor in metres, in the order of anchor_addr[]. See NOTE 19 below. */
+Anchor anchor_tab[NUM_ANCHORS] = {
+    {2,1,0},
+    {3,6,0},
+    {7,4,0}
+};
+
+/* Poll schedule: indexes in anchor_tab[] of the anchors ranged for the next fix. See NOTE 20 below. */
+static uint8_t sched[NUM_ANCHORS];
+static int n_sched;
+/* Bit i set while anchor i answers. */
+static uint32_t anchor_ok = (1UL << NUM_ANCHORS) - 1;
+/* Last position of the tag. */
+static Position tag_pos;
+static int have_fix = 0;
+
+static void update_schedule(void);
+static int sched_answered(void);
+static void zone_handover(void);
+static void apply_app_config(void);
+static void phy_app_config(void);
+
+#ifdef RNG_DUTY_CYCLE
+static dw_wake_stats_t wake_stats;
+#endif
+
+#ifdef RNG_RANDOM_ACCESS
+static ra_t ra;
+#endif
 
-void trilaterate(Anchor A1, Anchor A2, Anchor A3);
-void tril_do();
-Anchor A1={2,1,0};
-Anchor A2={3,6,0};
-Anchor A3={7,4,0};
+#ifdef TAG_JOIN
+static join_state_t join;
+static uint8_t join_sn = 0;
+#endif
+#ifdef TAG_JOIN
+static void tag_set_addr(uint16_t addr);
+static int tag_slotted(void);
+#endif
+/* The next run starts at the tag's slot; otherwise it contends. See NOTE 29 below. */
+static uint8_t run_in_slot = 0;
+static uint32_t rng_wait_ms(void);
+
+/* Sequence number of the polls, echoed by the anchors in their responses. See NOTE 30 below. */
+static uint8_t poll_sn = 0;
+
+/* Time of the last range to each anchor, and the DW IC time base it was taken in. See NOTE 31 below. */
+static range_stamp_t anchor_stamp[NUM_ANCHORS];
+static uint16_t dw_epoch = 0;
+
+#ifdef RNG_ADAPTIVE
+/* Interval between fixes given by the motion of the tag. */
+static rate_ctrl_t rate;
+static uint32_t fix_interval_ms = RATE_FAST_MS;
+#endif
+
+/* What range_resp() reads from the DW IC for one response, used by range_dist(). */
+typedef struct
+{
+    uint32_t poll_tx_ts, resp_rx_ts, poll_rx_ts, resp_tx_ts;
+    uint64_t poll_tx_ts64;
+    float clock_offset; /* Clock offset ratio of this response alone. */
+    float weight;       /* LOS/NLOS weight. */
+} range_raw_t;
+
+static void range_result(int cur, range_burst_t *b, float weight_sum, uint64_t ts0, uint64_t ts1);
+#ifdef RNG_PIPELINE
+static void range_pipeline(void);
+/* Waits between ranging runs for each fix. */
+#define RNG_WAITS_PER_FIX 1
+#else
+static int range_exchange(uint8_t *poll_msg, uint16_t poll_len, uint16_t addr, uint16_t *reply_dly, double *dist, float *weight, uint64_t *ts);
+static range_burst_t burst;
+#define RNG_WAITS_PER_FIX n_sched
+#endif
 /*! ------------------------------------------------------------------------------------------------------------------
  * @fn main()
  *
@@ -176,239 +316,766 @@ int ss_twr_initiator(void)
     /* Enabling LEDs here for debug so that for each TX the D1 LED will flash on DW3000 red eval-shield boards. */
     dwt_setleds(DWT_LEDS_ENABLE | DWT_LEDS_INIT_BLINK);
 
+    /* Use the calibrated antenna delay values if they are stored in OTP, the default values otherwise. See NOTE 2 below. */
+    ant_cal_load(&tx_ant_dly, &rx_ant_dly);
+
+    zone_apply(&config, tag_zone);
     /* Configure DW IC. See NOTE 13 below. */
     /* if the dwt_configure returns DWT_ERROR either the PLL or RX calibration has failed the host should reset the device */
-    if (dwt_configure(&config))
+    /* The profile, then TX spectrum, antenna delays, response delay and timeout, LNA/PA, CIR diagnostics. A switch at run time goes the
+     * same way. See NOTE 25 below. */
+    if (phy_reconfigure(&config, PHY_PROFILE, &phy, phy_app_config))
     {
         test_run_info((unsigned char *)"CONFIG FAILED     ");
         while (1) { };
     }
 
-    /* Configure the TX spectrum parameters (power, PG delay and PG count) */
-    dwt_configuretxrf(&txconfig_options);
+#ifdef PHY_BENCH
+    /* Air time of a poll, a response and an exchange in each profile, then back to PHY_PROFILE. See NOTE 25 below. */
+    {
+        phy_bench_t pb[PHY_PROFILE_NUM];
+        int i;
 
-    /* Apply default antenna delay value. See NOTE 2 below. */
-    dwt_setrxantennadelay(RX_ANT_DLY);
-    dwt_settxantennadelay(TX_ANT_DLY);
+        if (phy_bench(&config, sizeof(tx_poll_msg1), RX_BUF_LEN, pb) == DWT_SUCCESS)
+        {
+            for (i = 0; i < PHY_PROFILE_NUM; i++)
+            {
+                snprintf(dist_str, sizeof(dist_str), "%s X%lu/%lu", phy_profiles[i].name, (unsigned long)pb[i].xchg_us,
+                         (unsigned long)pb[i].calc_us);
+                test_run_info((unsigned char *)dist_str);
+            }
+        }
+    }
+#endif
 
-    /* Set expected response's delay and timeout. See NOTE 1 and 5 below.
-     * As this example only handles one incoming frame with always the same delay and timeout, those values can be set here once for all. */
-    dwt_setrxaftertxdelay(POLL_TX_TO_RESP_RX_DLY_UUS);
-    dwt_setrxtimeout(RESP_RX_TIMEOUT_UUS);
+#ifdef RNG_DUTY_CYCLE
+    /* Keep the configuration across DEEPSLEEP. See NOTE 22 below. */
+    dw_sleep_init();
+#endif
 
-    /* Next can enable TX/RX states output on GPIOs 5 and 6 to help debug, and also TX/RX LEDs
-     * Note, in real low power applications the LEDs should not be used. */
-    dwt_setlnapamode(DWT_LNA_ENABLE | DWT_PA_ENABLE);
+    /* Start per-anchor clock offset tracking from scratch. See NOTE 14 below. */
+    clk_track_init();
+
+    /* No position yet: start with the first anchors of the table. */
+    update_schedule();
+    ho_init(&ho);
+#ifdef RNG_RANDOM_ACCESS
+    /* Seeded from the chip IDs, so that tags started together draw different waits. */
+    ra_init(&ra, dwt_getpartid() ^ (uint32_t)dwt_getlotid(), RA_SLOT_MS);
+#endif
+#ifdef TAG_JOIN
+    /* The part ID identifies the tag to the coordinator. */
+    join_init(&join, dwt_getpartid());
+#endif
 
+#ifdef RNG_ADAPTIVE
+    rate_ctrl_init(&rate, RNG_IMU_HOOK);
+#endif
 
-    //int start_time, end_time, result;
     /* Loop forever initiating ranging exchanges. */
     while (1)
     {
     	/*******************앵커에게 문자열 프레임 전송******************************/
-    	//start_time=time(NULL);
-    	switch(frame_seq_nb)
-    	{
-    	case 0:
-            //dwt_configureframefilter(DWT_FF_ENABLE_802_15_4, DWT_FF_MAC_LE2_EN); // 프레임 필터링 기능 사용 (802.15.4 프로토콜, LE2_PEND의 주소가 source addr과 일치할 때)
-            //dwt_configure_le_address(SRC_A1, LE2);
-            dwt_writesysstatuslo(DWT_INT_TXFRS_BIT_MASK);
-            dwt_writetxdata(sizeof(tx_poll_msg1), tx_poll_msg1, 0); /* Zero offset in TX buffer. */
-            dwt_writetxfctrl(sizeof(tx_poll_msg1), 0, 1);          /* Zero offset in TX buffer, ranging. */
-            break;
-    	case 1:
-            dwt_writesysstatuslo(DWT_INT_TXFRS_BIT_MASK);
-            dwt_writetxdata(sizeof(tx_poll_msg2), tx_poll_msg2, 0); /* Zero offset in TX buffer. */
-            dwt_writetxfctrl(sizeof(tx_poll_msg2), 0, 1);          /* Zero offset in TX buffer, ranging. */
-            break;
-    	case 2:
-            dwt_writesysstatuslo(DWT_INT_TXFRS_BIT_MASK);
-            dwt_writetxdata(sizeof(tx_poll_msg3), tx_poll_msg3, 0); /* Zero offset in TX buffer. */
-            dwt_writetxfctrl(sizeof(tx_poll_msg3), 0, 1);          /* Zero offset in TX buffer, ranging. */
-            break;
-    	default:
-    		frame_seq_nb=0;
-    	}
-        /* Start transmission, indicating that a response is expected so that reception is enabled automatically after the frame is sent and the delay
-         * set by dwt_setrxaftertxdelay() has elapsed. */
-        dwt_starttx(DWT_START_TX_IMMEDIATE | DWT_RESPONSE_EXPECTED);
-
-        /* We assume that the transmission is achieved correctly, poll for reception of a frame or error/timeout. See NOTE 8 below. */
-        waitforsysstatus(&status_reg, NULL, (DWT_INT_RXFCG_BIT_MASK | SYS_STATUS_ALL_RX_TO | SYS_STATUS_ALL_RX_ERR), 0);
-
-
-        if (status_reg & DWT_INT_RXFCG_BIT_MASK)
+        int got_fix;
+        uint32_t delay_ms;
+
+#ifdef RNG_RANDOM_ACCESS
+        /* Listen before talking, backing off while the channel is busy. See NOTE 28 below. */
+        if (!run_in_slot)
+            ra_access(&ra);
+#endif
+#ifdef TAG_JOIN
+        /* Join, or renew the lease, at the start of the run. See NOTE 29 below. */
+        if (join_check(&join, portGetTickCnt()))
+            join_exchange(&join, join_sn++);
+        tag_set_addr((join.addr != JOIN_NO_ADDR) ? join.addr : TAG_ADDR);
+#endif
+#ifdef RNG_PIPELINE
+        /* Range every anchor of the schedule now: the fix is ready at the end of this run. See NOTE 24 below. */
+        range_pipeline();
+        frame_seq_nb = n_sched;
+#ifdef RNG_RANDOM_ACCESS
+        ra_feedback(&ra, sched_answered() > 0);
+#endif
+#else
+        float weight, weight_sum;
+        uint64_t ts, ts0 = 0, ts1 = 0;
+        int i, cur;
+
+        if (frame_seq_nb >= n_sched)
         {
-            uint16_t frame_len;
+            frame_seq_nb = 0;
+        }
+        cur = sched[frame_seq_nb];
 
-            /* Clear good RX frame event in the DW IC status register. */
-            dwt_writesysstatuslo(DWT_INT_RXFCG_BIT_MASK);
+        /* Run a burst of back-to-back exchanges with the current anchor and reduce it to one distance. See NOTE 15 below. */
+        range_burst_reset(&burst);
+        weight_sum = 0.0f;
+        for (i = 0; i < RNG_BURST_LEN; i++)
+        {
+            if (range_exchange(tx_poll_msgs[cur], sizeof(tx_poll_msg1), anchor_addr[cur], &reply_dly[cur], &distance, &weight, &ts) == 0)
+            {
+                if (burst.n == 0)
+                    ts0 = ts;
+                ts1 = ts;
+                range_burst_add(&burst, (float)distance);
+                weight_sum += weight;
+            }
+        }
+        range_result(cur, &burst, weight_sum, ts0, ts1);
+#ifdef RNG_RANDOM_ACCESS
+        ra_feedback(&ra, burst.n > 0);
+#endif
 
-            /* A frame has been received, read it into the local buffer. */
-            frame_len = dwt_getframelength();
-            if (frame_len <= sizeof(rx_buffer))
+        /* 다음 앵커 순서로 증가 */
+        frame_seq_nb++;
+#endif
+        if (frame_seq_nb >= n_sched)
+        {
+            frame_seq_nb = 0;
+            got_fix = tril_do();
+            zone_handover();
+            update_schedule();
+#ifdef RNG_ADAPTIVE
+            /* Range fast while moving, back off while still. See NOTE 21 below. */
+            fix_interval_ms = rate_ctrl_update(&rate, got_fix ? &tag_pos : NULL, portGetTickCnt());
+#else
+            (void)got_fix;
+#endif
+#ifdef RNG_DUTY_CYCLE
+            if (wake_stats.wakes >= WAKE_REPORT_WAKES)
             {
-                dwt_readrxdata(rx_buffer, frame_len, 0);
-                if (memcmp(rx_buffer, rx_resp_msg, ALL_MSG_COMMON_LEN) == 0)
-                {
-                    uint32_t poll_tx_ts, resp_rx_ts, poll_rx_ts, resp_tx_ts;
-                    int32_t rtd_init, rtd_resp;
-                    float clockOffsetRatio;
-
-                    /* Retrieve poll transmission and response reception timestamps. See NOTE 9 below. */
-                    poll_tx_ts = dwt_readtxtimestamplo32();
-                    resp_rx_ts = dwt_readrxtimestamplo32();
-
-                    /* Read carrier integrator value and calculate clock offset ratio. See NOTE 11 below. */
-                    clockOffsetRatio = ((float)dwt_readclockoffset()) / (uint32_t)(1 << 26);
-
-                    /* Get timestamps embedded in response message. */
-                    resp_msg_get_ts(&rx_buffer[RESP_MSG_POLL_RX_TS_IDX], &poll_rx_ts);
-                    resp_msg_get_ts(&rx_buffer[RESP_MSG_RESP_TX_TS_IDX], &resp_tx_ts);
-
-                    /* Compute time of flight and distance, using clock offset ratio to correct for differing local and remote clock rates */
-                    rtd_init = resp_rx_ts - poll_tx_ts;
-                    rtd_resp = resp_tx_ts - poll_rx_ts;
-
-                    tof = ((rtd_init - rtd_resp * (1 - clockOffsetRatio)) / 2.0) * DWT_TIME_UNITS;
-                    distance = tof * SPEED_OF_LIGHT;
-                    /* Display computed distance on LCD. */
-                	switch(frame_seq_nb)
-                	{
-                	case 0:
-                		snprintf(dist_str, sizeof(dist_str), "A1: %3.2f m", distance);
-                		A1.distance=distance;
-                        /* 다음 앵커 순서로 증가 */
-                        frame_seq_nb++;
-
-
-                        break;
-                	case 1:
-                		snprintf(dist_str, sizeof(dist_str), "A2: %3.2f m", distance);
-                		A2.distance=distance;
-                        /* 다음 앵커 순서로 증가 */
-                        frame_seq_nb++;
-
-                        break;
-                	case 2:
-                		snprintf(dist_str, sizeof(dist_str), "A3: %3.2f m", distance);
-                		A3.distance=distance;
-                        /* 다음 앵커 순서로 증가 */
-                        frame_seq_nb=0;
-                        tril_do();
-
-                        break;
-                	default:
-                		frame_seq_nb=0;
-
-
-                	}
-                    test_run_info((unsigned char *)dist_str);
-                }
-                /*
-                end_time=time(NULL);
-                result=(double)(end_time-start_time);
-                snprintf(dist_str, sizeof(dist_str), "time: %3.2f", result);
+                uint32_t avg_100 = wake_stats.sum_ms * 100 / wake_stats.wakes;
+
+                snprintf(dist_str, sizeof(dist_str), "WK %lu.%02lu/%lu ms", (unsigned long)(avg_100 / 100), (unsigned long)(avg_100 % 100),
+                         (unsigned long)wake_stats.max_ms);
                 test_run_info((unsigned char *)dist_str);
-				*/
+                wake_stats.wakes = wake_stats.sum_ms = wake_stats.max_ms = 0;
+            }
+#endif
+        }
+
+        /* Execute a delay between ranging exchanges. */
+        delay_ms = rng_wait_ms();
+        run_in_slot = 0;
+#ifdef TAG_JOIN
+        /* A tag with a slot keeps its rate and takes its slot for the phase: the first slot after the wait, or for a tag ranging more
+         * than once a cycle, its slot when it comes within the wait and a contended run otherwise. See NOTE 29 below. */
+        if (tag_slotted())
+        {
+            uint32_t slot_wait = join_slot_wait(&join, portGetTickCnt(), (delay_ms >= JOIN_CYCLE_MS) ? delay_ms : 0);
+
+            if (delay_ms >= JOIN_CYCLE_MS || slot_wait <= delay_ms)
+            {
+                delay_ms = slot_wait;
+                run_in_slot = 1;
             }
         }
+#endif
+#ifdef RNG_RANDOM_ACCESS
+        /* A random number of contention slots on top, drawn from the window the collisions set. */
+        if (!run_in_slot)
+            delay_ms += ra_backoff_ms(&ra);
+#endif
+#ifdef RNG_DUTY_CYCLE
+        /* Deep sleep the DW IC while waiting, then restore it without a full initialisation. See NOTE 22 below. */
+        if (delay_ms >= DW_SLEEP_MIN_MS)
+        {
+            dw_sleep_enter();
+            Sleep(delay_ms);
+            dw_sleep_wake(&wake_stats);
+            /* The DW IC system time restarted. */
+            dw_epoch++;
+            apply_app_config();
+        }
         else
+#endif
         {
-            /* Clear RX error/timeout events in the DW IC status register. */
-            dwt_writesysstatuslo(SYS_STATUS_ALL_RX_TO | SYS_STATUS_ALL_RX_ERR);
+            Sleep(delay_ms);
         }
-        //dwt_writesysstatuslo(DWT_INT_TXFRS_BIT_MASK);
-        //dwt_writetxdata(sizeof(arr1), arr1, 0); /* Zero offset in TX buffer. */
-        //dwt_writetxfctrl(sizeof(arr1), 0, 1);
-        //dwt_starttx(DWT_START_TX_IMMEDIATE);
+    }
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn range_poll()
+ *
+ * @brief Send a poll to an anchor, with reception of its response enabled automatically after the TX.
+ *
+ * @param  poll_msg   poll frame addressed to the anchor
+ * @param  poll_len   length of the poll frame
+ * @param  reply_dly  response delay last announced by the anchor, 0 if not known
+ *
+ * @return none
+ */
+static void range_poll(uint8_t *poll_msg, uint16_t poll_len, uint16_t reply_dly)
+{
+    uint32_t rx_dly, rx_to;
+
+    /* Open the RX window around the response delay this anchor announced last. See NOTE 23 below. */
+    reply_tune_window(reply_dly, RESP_RX_LEAD_UUS, RESP_RX_TIMEOUT_UUS, PHY_REPLY_OFS_UUS(phy), &rx_dly, &rx_to);
+    dwt_setrxaftertxdelay(rx_dly);
+    dwt_setrxtimeout(rx_to);
+
+    /* A new sequence number for each poll, and only the anchor polled may answer. See NOTE 30 below. */
+    poll_msg[ALL_MSG_SN_IDX] = poll_sn++;
+    rx_resp_msg[7] = poll_msg[5];
+    rx_resp_msg[8] = poll_msg[6];
+
+    dwt_writesysstatuslo(DWT_INT_TXFRS_BIT_MASK);
+    dwt_writetxdata(poll_len, poll_msg, 0); /* Zero offset in TX buffer. */
+    dwt_writetxfctrl(poll_len, 0, 1);       /* Zero offset in TX buffer, ranging. */
+
+    /* Start transmission, indicating that a response is expected so that reception is enabled automatically after the frame is sent and the delay
+     * set by dwt_setrxaftertxdelay() has elapsed. */
+    dwt_starttx(DWT_START_TX_IMMEDIATE | DWT_RESPONSE_EXPECTED);
+#ifdef RNG_DUTY_CYCLE
+    dw_sleep_first_poll(&wake_stats);
+#endif
+}
 
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn range_resp()
+ *
+ * @brief Wait for the response to the last poll and read everything the distance needs from the DW IC (time-stamps, clock offset, CIR
+ *        diagnostics), so that the next poll can be sent before the distance is computed.
+ *
+ * @param  reply_dly  in/out, response delay last announced by the anchor, 0 if not known
+ * @param  raw        output, values read for range_dist()
+ *
+ * @return 0 on success, -1 on RX error/timeout or unexpected frame
+ */
+static int range_resp(uint16_t *reply_dly, range_raw_t *raw)
+{
+    /* We assume that the transmission is achieved correctly, poll for reception of a frame or error/timeout. See NOTE 8 below. */
+    waitforsysstatus(&status_reg, NULL, (DWT_INT_RXFCG_BIT_MASK | SYS_STATUS_ALL_RX_TO | SYS_STATUS_ALL_RX_ERR), 0);
 
+    if (status_reg & DWT_INT_RXFCG_BIT_MASK)
+    {
+        uint16_t frame_len;
 
+        /* Clear good RX frame event in the DW IC status register. */
+        dwt_writesysstatuslo(DWT_INT_RXFCG_BIT_MASK);
 
-        /* Execute a delay between ranging exchanges. */
-        Sleep(RNG_DELAY_MS);
+        /* A frame has been received, read it into the local buffer. */
+        frame_len = dwt_getframelength();
+        if (frame_len <= sizeof(rx_buffer))
+        {
+            /* The header is compared with the sequence number of the last poll sent, which the anchor echoes. See NOTE 30 below. */
+            dwt_readrxdata(rx_buffer, frame_len, 0);
+            rx_resp_msg[ALL_MSG_SN_IDX] = (uint8_t)(poll_sn - 1);
+            if (memcmp(rx_buffer, rx_resp_msg, ALL_MSG_COMMON_LEN) == 0)
+            {
+                nlos_result_t nlos;
+
+                /* Retrieve poll transmission and response reception timestamps. See NOTE 9 below. */
+                raw->poll_tx_ts = dwt_readtxtimestamplo32();
+                raw->resp_rx_ts = dwt_readrxtimestamplo32();
+                raw->poll_tx_ts64 = get_tx_timestamp_u64();
+
+                /* Read carrier integrator value and calculate clock offset ratio. See NOTE 11 below. */
+                raw->clock_offset = ((float)dwt_readclockoffset()) / (uint32_t)(1 << 26);
+
+                /* Get timestamps embedded in response message. */
+                resp_msg_get_ts(&rx_buffer[RESP_MSG_POLL_RX_TS_IDX], &raw->poll_rx_ts);
+                resp_msg_get_ts(&rx_buffer[RESP_MSG_RESP_TX_TS_IDX], &raw->resp_tx_ts);
+
+                /* Follow the anchor's response delay; a responder without the field gets the wide window. */
+                if (frame_len >= sizeof(rx_resp_msg))
+                    *reply_dly = rx_buffer[RESP_MSG_REPLY_DLY_IDX] | (rx_buffer[RESP_MSG_REPLY_DLY_IDX + 1] << 8);
+                else
+                    *reply_dly = 0;
+
+                /* Classify the response from its CIR diagnostics. See NOTE 16 below. */
+                nlos_read(&nlos);
+                raw->weight = nlos.weight;
+                return 0;
+            }
+        }
+        return -1;
+    }
+
+    /* Clear RX error/timeout events in the DW IC status register. */
+    dwt_writesysstatuslo(SYS_STATUS_ALL_RX_TO | SYS_STATUS_ALL_RX_ERR);
+
+    /* The anchor's delay may have moved further than the window covers: search the whole range next time. */
+    *reply_dly = 0;
+    return -1;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn range_dist()
+ *
+ * @brief Compute the distance from the values read by range_resp(). Only uses the MCU.
+ *
+ * @param  addr  short address of the anchor, used for clock offset tracking
+ * @param  raw   values read by range_resp()
+ *
+ * @return distance in metres
+ */
+static double range_dist(uint16_t addr, const range_raw_t *raw)
+{
+    int32_t rtd_init, rtd_resp;
+    float clockOffsetRatio;
+
+    /* Replace the single noisy reading by the anchor's smoothed clock offset ratio. See NOTE 14 below. */
+    clockOffsetRatio = clk_track_update(addr, raw->clock_offset, raw->poll_tx_ts64, raw->poll_rx_ts);
+
+    /* Compute time of flight and distance, using clock offset ratio to correct for differing local and remote clock rates */
+    rtd_init = raw->resp_rx_ts - raw->poll_tx_ts;
+    rtd_resp = raw->resp_tx_ts - raw->poll_rx_ts;
+
+    tof = ((rtd_init - rtd_resp * (1 - clockOffsetRatio)) / 2.0) * DWT_TIME_UNITS;
+    return tof * SPEED_OF_LIGHT;
+}
+
+#ifndef RNG_PIPELINE
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn range_exchange()
+ *
+ * @brief Run one SS TWR exchange with an anchor.
+ *
+ * @param  poll_msg   poll frame addressed to the anchor
+ * @param  poll_len   length of the poll frame
+ * @param  addr       short address of the anchor, used for clock offset tracking
+ * @param  reply_dly  in/out, response delay last announced by the anchor, 0 if not known
+ * @param  dist       output, computed distance in metres
+ * @param  weight     output, LOS/NLOS weight of the response
+ * @param  ts         output, DW IC system time of the poll TX
+ *
+ * @return 0 on success, -1 on RX error/timeout or unexpected frame
+ */
+static int range_exchange(uint8_t *poll_msg, uint16_t poll_len, uint16_t addr, uint16_t *reply_dly, double *dist, float *weight, uint64_t *ts)
+{
+    range_raw_t raw;
+
+    range_poll(poll_msg, poll_len, *reply_dly);
+    if (range_resp(reply_dly, &raw) != 0)
+        return -1;
+    *dist = range_dist(addr, &raw);
+    *weight = raw.weight;
+    *ts = raw.poll_tx_ts64;
+    return 0;
+}
+#endif
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn range_result()
+ *
+ * @brief Reduce the burst of an anchor to its distance for the next fix, or leave the anchor out if it did not answer.
+ *
+ * @param  cur         index of the anchor in anchor_tab[]
+ * @param  b           distances measured with the anchor
+ * @param  weight_sum  sum of the LOS/NLOS weights of those distances
+ * @param  ts0, ts1    DW IC system time of the first and last of those distances
+ *
+ * @return none
+ */
+static void range_result(int cur, range_burst_t *b, float weight_sum, uint64_t ts0, uint64_t ts1)
+{
+    float dist, var;
+    int n_ok = b->n;
+
+    if (range_burst_reduce(b, &dist, &var) > 0)
+    {
+        /* Display computed distance on LCD. */
+        snprintf(dist_str, sizeof(dist_str), "A%d: %3.2f m", cur + 1, dist);
+        anchor_tab[cur].distance = dist;
+        anchor_tab[cur].variance = var;
+        anchor_tab[cur].weight = weight_sum / n_ok;
+        anchor_ok |= 1UL << cur;
+        /* The distance is that of the middle of the burst. See NOTE 31 below. */
+        range_stamp(&anchor_stamp[cur], dist, ts0 + (((ts1 - ts0) & 0xFFFFFFFFFFULL) >> 1), portGetTickCnt(), dw_epoch);
+        test_run_info((unsigned char *)dist_str);
+    }
+    else
+    {
+        /* No answer: leave the anchor out of this fix and of the next selections. See NOTE 20 below. */
+        anchor_tab[cur].distance = 0.0;
+        anchor_ok &= ~(1UL << cur);
     }
 }
 
+#ifdef RNG_PIPELINE
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn range_pipeline()
+ *
+ * @brief Range all the anchors of the schedule for one fix, RNG_BURST_LEN times each, taking the anchors in turn. As soon as a response has
+ *        been read the next poll is sent, and the distance of that response is computed while the next exchange is on air. See NOTE 24 below.
+ *
+ * @param  none
+ *
+ * @return none
+ */
+static void range_pipeline(void)
+{
+    static range_burst_t bursts[NUM_ANCHORS];
+    float weight_sum[NUM_ANCHORS];
+    uint64_t ts0[NUM_ANCHORS], ts1[NUM_ANCHORS];
+    range_raw_t raw;
+    int k, total, cur, next, ok;
+
+    if (n_sched == 0)
+        return;
+
+    for (k = 0; k < n_sched; k++)
+    {
+        range_burst_reset(&bursts[sched[k]]);
+        weight_sum[sched[k]] = 0.0f;
+    }
+
+    total = n_sched * RNG_BURST_LEN;
+    cur = sched[0];
+    range_poll(tx_poll_msgs[cur], sizeof(tx_poll_msg1), reply_dly[cur]);
+    for (k = 0; k < total; k++)
+    {
+        ok = range_resp(&reply_dly[cur], &raw);
+
+        /* Everything needed from the DW IC has been read: start the next exchange before doing the arithmetic. */
+        next = sched[(k + 1) % n_sched];
+        if (k + 1 < total)
+            range_poll(tx_poll_msgs[next], sizeof(tx_poll_msg1), reply_dly[next]);
 
+        if (ok == 0)
+        {
+            if (bursts[cur].n == 0)
+                ts0[cur] = raw.poll_tx_ts64;
+            ts1[cur] = raw.poll_tx_ts64;
+            range_burst_add(&bursts[cur], (float)range_dist(anchor_addr[cur], &raw));
+            weight_sum[cur] += raw.weight;
+        }
+        cur = next;
+    }
 
-void trilaterate(Anchor A1, Anchor A2, Anchor A3)
+    for (k = 0; k < n_sched; k++)
+        range_result(sched[k], &bursts[sched[k]], weight_sum[sched[k]], ts0[sched[k]], ts1[sched[k]]);
+}
+#endif
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn apply_app_config()
+ *
+ * @brief Settings written on top of dwt_configure(), at start-up and again after each wake-up from DEEPSLEEP. They are a few register writes,
+ *        far cheaper than dwt_initialise() and dwt_configure(). See NOTE 22 below.
+ *
+ * @param  none
+ *
+ * @return none
+ */
+static void apply_app_config(void)
 {
-	double A = 2*(A2.x - A1.x);
-	double B = 2*(A2.y - A2.y);
-	double C = ((pow(A1.distance, 2.0)) - (pow(A2.distance, 2.0)) - (pow(A1.x, 2.0)) + (pow(A2.x, 2.0)) - (pow(A1.y, 2.0)) + (pow(A2.y, 2.0)));
-	double D = 2*(A3.x - A2.x);
-	double E = 2*(A3.y = A2.y);
-	double F = (pow(A2.distance, 2.0) - pow(A3.distance, 2.0) - pow(A2.x, 2.0) + pow(A3.x, 2.0) - pow(A2.y, 2.0) + pow(A3.y, 2.0));
+    /* Configure the TX spectrum parameters (power, PG delay and PG count) */
+    dwt_configuretxrf(zone_txrf(config.chan));
 
-	if( ((B * D) - (E * A))==0  || ((A * E) - (D * B))==0)
-		return;
+    /* Apply the antenna delay values. See NOTE 2 below. */
+    dwt_setrxantennadelay(rx_ant_dly);
+    dwt_settxantennadelay(tx_ant_dly);
 
-	double x = ( (F * B) - (E * C)) / ((B * D) - (E * A));
-	double y = ( (F * A) - (D * C)) / ((A * E) - (D * B));
+    /* Set expected response's delay and timeout. See NOTE 1 and 5 below.
+     * range_exchange() replaces them before each poll with the window of the anchor polled. See NOTE 23 below. */
+    dwt_setrxaftertxdelay(POLL_TX_TO_RESP_RX_DLY_UUS);
+    dwt_setrxtimeout(RESP_RX_TIMEOUT_UUS);
+
+    /* Next can enable TX/RX states output on GPIOs 5 and 6 to help debug, and also TX/RX LEDs
+     * Note, in real low power applications the LEDs should not be used. */
+    dwt_setlnapamode(DWT_LNA_ENABLE | DWT_PA_ENABLE);
+
+    /* Log the CIR diagnostics used to classify each response as LOS/NLOS. See NOTE 16 below. */
+    nlos_init();
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn phy_app_config()
+ *
+ * @brief Settings depending on the PHY profile, called by phy_reconfigure() once phy points at the new one. The response delays announced
+ *        by the anchors belong to the old profile's range, so each anchor's RX window goes back to the one covering the whole range until
+ *        it answers again. See NOTE 23 and 25 below.
+ *
+ * @param  none
+ *
+ * @return none
+ */
+static void phy_app_config(void)
+{
+    int i;
+
+    for (i = 0; i < NUM_ANCHORS; i++)
+        reply_dly[i] = 0;
+    apply_app_config();
+}
+
+/* Bit i set if anchor i is in the given zone. */
+static uint32_t zone_anchors(uint8_t zone)
+{
+    uint32_t mask = 0;
+    int i;
+
+    for (i = 0; i < NUM_ANCHORS; i++)
+    {
+        if (anchor_zone[i] == zone)
+            mask |= 1UL << i;
+    }
+    return mask;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn update_schedule()
+ *
+ * @brief Choose the anchors to range for the next fix, among those of the tag's zone, from the last position and the anchors that answer.
+ *        See NOTE 20 below.
+ *
+ * @param  none
+ *
+ * @return none
+ */
+static void update_schedule(void)
+{
+    static int fixes = 0;
+    uint32_t in_zone = zone_anchors(tag_zone);
 
-	sprintf(&arr1[2], "%f",x);
-	sprintf(&arr1[12], "%f\n",y);
+    if (++fixes >= SEL_RETRY_FIXES)
+    {
+        fixes = 0;
+        anchor_ok = (1UL << NUM_ANCHORS) - 1;
+    }
+    n_sched = anchor_select(anchor_tab, NUM_ANCHORS, anchor_ok & in_zone, have_fix ? &tag_pos : NULL, SEL_ANCHORS, sched);
+    if (n_sched < 3)
+    {
+        /* Not enough anchors answering or in range: try them all again. */
+        anchor_ok = (1UL << NUM_ANCHORS) - 1;
+        n_sched = anchor_select(anchor_tab, NUM_ANCHORS, in_zone, NULL, SEL_ANCHORS, sched);
+    }
+}
 
-	test_run_info(arr1);
-	//udp_echoclient_send(&arr1);
-	Sleep(100);
+#ifdef TAG_JOIN
+/* Use an address in the polls and accept responses addressed to it. */
+static void tag_set_addr(uint16_t addr)
+{
+    int i;
 
+    for (i = 0; i < NUM_ANCHORS; i++)
+    {
+        tx_poll_msgs[i][7] = (uint8_t)addr;
+        tx_poll_msgs[i][8] = (uint8_t)(addr >> 8);
+    }
+    rx_resp_msg[5] = (uint8_t)addr;
+    rx_resp_msg[6] = (uint8_t)(addr >> 8);
 }
 
-float norm (Anchor p) // get the norm of a vector
+/* Non-zero if the tag holds a slot. */
+static int tag_slotted(void)
 {
+    return join.slot != JOIN_NO_SLOT;
+}
+#endif
 
-    return pow(pow(p.x,2)+pow(p.y,2),.5);
+/* Number of anchors of the schedule that answered in the last run. */
+static int sched_answered(void)
+{
+    int i, answered = 0;
 
+    for (i = 0; i < n_sched; i++)
+    {
+        if (anchor_tab[sched[i]].distance > 0.0)
+            answered++;
+    }
+    return answered;
 }
-void trilateration(Anchor point1, Anchor point2, Anchor point3)
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn zone_handover()
+ *
+ * @brief Called after each fix: update the link quality to the tag's zone and, at most every HO_SCAN_INTERVAL_MS, scan the zone the position
+ *        points to, or the next zone with anchors if the link is failing, and hand over to it if enough of its anchors are heard.
+ *        See NOTE 27 below.
+ *
+ * @param  none
+ *
+ * @return none
+ */
+static void zone_handover(void)
 {
-	Anchor resultPose;
-	//Norm은 벡터의 길이 혹은 크기를 측정하는 방법
-    //unit vector in a direction from point1 to point 2
-    double p2p1Distance = pow(pow(point2.x-point1.x,2) + pow(point2.y-   point1.y,2),0.5);
-    Anchor ex = {(point2.x-point1.x)/p2p1Distance, (point2.y-point1.y)/p2p1Distance};
-    Anchor aux = {point3.x-point1.x,point3.y-point1.y};
+    uint16_t addr[NUM_ANCHORS];
+    int cand, i;
 
-    //Norm이 측정한 벡터의 크기는 원점에서 벡터 좌표까지의 거리 혹은 Magnitude
-    //signed magnitude of the x component
-    double i = ex.x * aux.x + ex.y * aux.y;
+    ho_link(&ho, sched_answered(), n_sched);
 
-    //the unit vector in the y direction.
-    Anchor aux2 = { point3.x-point1.x-i*ex.x, point3.y-point1.y-i*ex.y};
-    Anchor ey = { aux2.x / norm (aux2), aux2.y / norm (aux2) };
+    if (portGetTickCnt() - ho.last_scan_ms < HO_SCAN_INTERVAL_MS)
+        return;
 
-    //the signed magnitude of the y component
-    double j = ey.x * aux.x + ey.y * aux.y;
+    cand = have_fix ? ho_candidate(anchor_tab, anchor_zone, NUM_ANCHORS, &tag_pos, tag_zone) : -1;
+    if (cand < 0)
+    {
+        if (ho.link >= HO_LINK_MIN)
+            return;
 
-    //coordinates
-    double x = (pow(point1.distance,2) - pow(point2.distance,2) + pow(p2p1Distance,2))/ (2 * p2p1Distance);
-    double y = (pow(point1.distance,2) - pow(point3.distance,2) + pow(i,2) + pow(j,2))/(2*j) - i*x/j;
+        /* Lost without a better zone in sight: try the others in turn. */
+        for (i = 0; i < ZONE_NUM; i++)
+        {
+            ho.next = (uint8_t)((ho.next + 1) % ZONE_NUM);
+            if (ho.next != tag_zone && zone_anchors(ho.next) != 0)
+                break;
+        }
+        if (i == ZONE_NUM)
+            return;
+        cand = ho.next;
+    }
 
-    //result coordinates
-    double finalX = point1.x+ x*ex.x + y*ey.x;
-    double finalY = point1.y+ x*ex.y + y*ey.y;
+    /* Anchor addresses as they are in the frames. */
+    for (i = 0; i < NUM_ANCHORS; i++)
+        addr[i] = tx_poll_msgs[i][5] | (tx_poll_msgs[i][6] << 8);
 
-	//sprintf(&arr1[2], "%f\n",finalX);
-	//sprintf(&arr2[2], "%f\n",finalY);
+    ho.scans++;
+    if (ho_scan(&config, (uint8_t)cand, addr, anchor_zone, NUM_ANCHORS) >= HO_MIN_ANCHORS)
+    {
+        /* The position is kept: the new zone's anchors are chosen around it. */
+        tag_zone = (uint8_t)cand;
+        anchor_ok = (1UL << NUM_ANCHORS) - 1;
+        ho.link = 1.0f;
+        ho.handovers++;
+#ifdef TAG_JOIN
+        /* The lease was the old zone's coordinator's: join the new one. */
+        join_reset(&join);
+#endif
+    }
+    else
+    {
+        zone_switch(&config, tag_zone);
+    }
+    ho.last_scan_ms = portGetTickCnt();
+}
 
-	test_run_info(arr1);
-	Sleep(100);
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn rng_wait_ms()
+ *
+ * @brief Wait between two ranging runs, before any contention backoff or slot: RNG_DELAY_MS, or the adaptive interval spread over the
+ *        runs of a fix.
+ *
+ * @param  none
+ *
+ * @return wait in milliseconds
+ */
+static uint32_t rng_wait_ms(void)
+{
+#ifdef RNG_ADAPTIVE
+    return fix_interval_ms / RNG_WAITS_PER_FIX;
+#else
+    return RNG_DELAY_MS;
+#endif
+}
 
-	//unsigned char result_arr[32] = strcat(arr1, arr2);
+#ifdef RNG_TIME_ALIGN
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn tril_align()
+ *
+ * @brief Bring the ranges of the schedule to the time of the newest one and keep those that can be used. See NOTE 31 below.
+ *
+ * @param  set  in/out, anchors of the schedule in order, packed to the ones kept
+ *
+ * @return number of anchors kept
+ */
+static int tril_align(Anchor *set)
+{
+    range_stamp_t st[NUM_ANCHORS];
+    double dist[NUM_ANCHORS];
+    uint8_t keep[NUM_ANCHORS];
+    uint32_t extrap_ms = ALIGN_EXTRAP_MS;
+    int i, n = 0;
 
+#ifndef RNG_PIPELINE
+    {
+        /* One run per anchor: the oldest range of the fix is n_sched - 1 runs old, each a wait and the run itself, with a contention
+         * backoff possibly on top, ALIGN_EXTRAP_MS of margin. */
+        uint32_t wait_ms = rng_wait_ms();
+
+#ifdef TAG_JOIN
+        /* A slotted tag's wait runs on to its slot, up to a cycle more. */
+        if (tag_slotted() && wait_ms >= JOIN_CYCLE_MS)
+            wait_ms += JOIN_CYCLE_MS;
+#endif
+        extrap_ms = (uint32_t)(n_sched - 1) * (wait_ms + ALIGN_EXTRAP_MS);
+    }
+#endif
+
+    for (i = 0; i < n_sched; i++)
+    {
+        st[i] = anchor_stamp[sched[i]];
+        /* No answer for this fix. */
+        if (set[i].distance <= 0.0)
+            st[i].valid = 0;
+    }
+    range_align(st, n_sched, ALIGN_WINDOW_MS, extrap_ms, dist, keep);
+
+    for (i = 0; i < n_sched; i++)
+    {
+        if (keep[i])
+        {
+            set[n] = set[i];
+            set[n++].distance = dist[i];
+        }
+    }
+    return n;
 }
+#endif
 
-void tril_do()
+int tril_do(void)
 {
+    Anchor set[NUM_ANCHORS];
+    Position pos;
+    char pos_str[32];
+    int i, n, ok = 0;
+#ifdef TRIL_ROBUST
+    uint32_t inliers = 0xFFFFFFFFUL;
+#endif
     /********************************************************************************************/
-	if((A1.distance>0) && (A2.distance>0) && (A3.distance>0))
+	/* Weighted solver: NLOS and noisy ranges count less. See NOTE 16 below. */
+	for (i = 0; i < n_sched; i++)
+	{
+		set[i] = anchor_tab[sched[i]];
+	}
+	n = n_sched;
+#ifdef RNG_TIME_ALIGN
+	/* Ranges measured at different times: bring them to the newest, or leave them out. See NOTE 31 below. */
+	n = tril_align(set);
+#endif
+	if(n >= 3)
 	{
-		trilaterate(A1,A2,A3);
-		//trilateration(A1,A2,A3);
+		/* Known tag height: solve in the tag's plane. See NOTE 19 below. */
+		trilat_project(set, n, TAG_HEIGHT_M, set);
+		pos.z = TAG_HEIGHT_M;
+#ifdef TRIL_ROBUST
+		/* Reject ranges inconsistent with the others. See NOTE 17 below. */
+		ok = (trilat_solve_robust(set, n, &pos, &inliers) >= 3);
+#else
+		ok = (trilat_solve(set, n, &pos) == 0);
+#endif
+#ifdef TRIL_REFINE
+		/* Start from the linear solution, or from the previous fix when the geometry is too poor for it. See NOTE 18 below. */
+		if (!ok && have_fix)
+		{
+			pos = tag_pos;
+			ok = 1;
+		}
+		if (ok)
+		{
+#ifdef TRIL_ROBUST
+			for (i = 0; i < n; i++)
+			{
+				if (!(inliers & (1UL << i)))
+					set[i].weight = 0.0;
+			}
+#endif
+			ok = (trilat_refine(set, n, &pos) >= 0);
+		}
+#endif
+		if (ok)
+		{
+			tag_pos = pos;
+			have_fix = 1;
+			snprintf(pos_str, sizeof(pos_str), "%.2f,%.2f,%.2f", pos.x, pos.y, pos.z);
+			test_run_info((unsigned char *)pos_str);
+		}
 	}
+	return ok;
 }
 
 
@@ -456,6 +1123,7 @@ void tril_do()
  *    Response message:
  *     - byte 10 -> 13: poll message reception timestamp.
  *     - byte 14 -> 17: response message transmission timestamp.
+ *     - byte 18/19: response delay in UWB microseconds, see NOTE 23 below.
  *    All messages end with a 2-byte checksum automatically set by DW IC.
  * 4. Source and destination addresses are hard coded constants in this example to keep it simple but for a real product every device should have a
  *    unique ID. Here, 16-bit addressing is used to keep the messages as short as possible but, in an actual application, this should be done only
@@ -484,4 +1152,130 @@ void tril_do()
  *     thereafter.
  * 13. Desired configuration by user may be different to the current programmed configuration. dwt_configure is called to set desired
  *     configuration.
+ * 14. The carrier integrator reading of a single short response frame is noisy, and in SS-TWR that noise is multiplied by the whole response delay.
+ *     clk_track_update() (clock_track.c) keeps one smoothed clock offset ratio per anchor, blending the carrier integrator readings with the drift
+ *     measured between the local poll TX time-stamps and the remote poll RX time-stamps of consecutive exchanges. The time-stamp pair is only used
+ *     when two exchanges with the same anchor are between 1 ms and ~67 ms apart (the remote time-stamp is 32 bits), e.g. back-to-back exchanges;
+ *     otherwise only the carrier integrator is filtered. With a stable ratio the responders' POLL_RX_TO_RESP_TX_DLY_UUS can be reduced without adding
+ *     a range bias.
+ * 15. A single SS-TWR sample is noisy, so each anchor is ranged RNG_BURST_LEN times back to back (about 1 ms per exchange) and the burst is reduced
+ *     by range_burst_reduce() (range_filter.c): samples far from the median are dropped, the rest is trimmed and averaged. The variance of the
+ *     samples kept is stored with the distance in the Anchor so the position solver can weight it. RNG_BURST_LEN must not exceed RANGE_BURST_MAX.
+ * 16. Every response is classified LOS / possible NLOS / NLOS by nlos_read() (nlos.c) from the Ipatov CIR diagnostics: the ratio of total received
+ *     power to first path power (below 6 dB is LOS, above 10 dB is NLOS) and, in between, the distance from first path to peak path. Only the ratio
+ *     is needed, so no logarithm is taken and the check is cheap enough for every frame. The anchor's weight is the mean weight of its burst and
+ *     trilat_solve() (trilateration.c) weights each range by weight / (variance + TRILAT_VAR_FLOOR).
+ * 17. With TRIL_ROBUST defined, trilat_solve_robust() (trilateration.c) solves 3-anchor subsets, keeps the one most anchors agree with (residual
+ *     below TRILAT_INLIER_M) and refines it over those inliers with Huber reweighting, so a single reflected or blocked range is dropped rather
+ *     than pulling the fix. The number of subsets is capped at TRILAT_MAX_SUBSETS and the reweighting at TRILAT_IRLS_ITER passes, which bounds the
+ *     solve time whatever the number of anchors. The bitmask of inliers can be reported to flag bad anchors. With only 3 anchors there is no
+ *     redundancy and the result is the same as trilat_solve(): with the three anchors of anchor_tab[] here, this path is dormant until a
+ *     fourth anchor is added to the table (NOTE 20).
+ * 18. The linear solvers square the ranges and subtract one anchor's equation from the others, which loses accuracy when the anchors are close to
+ *     collinear or the tag is outside their hull. With TRIL_REFINE defined, trilat_refine() (trilateration.c) then minimises the weighted range
+ *     residuals directly (Levenberg-Marquardt), over the inliers only when TRIL_ROBUST is also defined. Starting from the linear solution it usually
+ *     stops after one or two iterations (TRILAT_REFINE_ITER is the cap), so it costs little next to a ranging burst. When the linear solver fails
+ *     because the anchors are collinear, the previous fix is used as the starting point instead.
+ * 19. Anchors are usually mounted near the ceiling and the tag is carried around 1 m, so the measured ranges are slant ranges and solving them in
+ *     2D biases the position. Each anchor has a z and the tag's height is given by TAG_HEIGHT_M; trilat_project() (trilateration.c) turns the slant
+ *     ranges into ranges in the tag's horizontal plane (scaling their variance accordingly), and the 2D solvers then run unchanged, at the same cost.
+ *     With all anchors and the tag at z = 0 this is the plain 2D solve. The position is reported as "x,y,z". With 4 or more anchors at different
+ *     heights, trilat_solve_3d() and trilat_refine_3d() solve for z as well.
+ * 20. The tag does not range with every anchor of anchor_tab[] (anchor_addr[] and tx_poll_msgs[] list them in the same order). After each fix,
+ *     anchor_select() (anchor_select.c) picks the SEL_ANCHORS anchors that give the lowest horizontal dilution of precision seen from that fix,
+ *     among those within ANCHOR_SEL_MAX_RANGE_M that answered, and they become the poll schedule for the next fix. Good geometry from fewer
+ *     anchors gives the same accuracy for fewer exchanges, and anchors with poor geometry around the tag (e.g. almost in line with it) are avoided.
+ *     An anchor that does not answer is dropped from the selection for SEL_RETRY_FIXES fixes. With SEL_ANCHORS equal to the table size every
+ *     anchor is ranged, as before, and anchor_select() only leaves out the anchors that did not answer or are out of range. This is the case
+ *     here, with the three anchors A1 to A3: the selection, and TRIL_ROBUST (NOTE 17), take effect once anchor_tab[], anchor_addr[],
+ *     tx_poll_msgs[] and anchor_zone[] list more anchors than SEL_ANCHORS, up to TRILAT_MAX_ANCHORS.
+ * 21. With RNG_ADAPTIVE defined, the fixed RNG_DELAY_MS is replaced by an interval from rate_ctrl_update() (rate_ctrl.c), spread over the anchors of
+ *     a fix. An alpha-beta tracker on the fixes gives the tag's speed; above RATE_MOVING_MPS, or after a fix RATE_MOVE_M away from the prediction,
+ *     the tag ranges every RATE_FAST_MS. After RATE_STILL_FIXES still fixes the interval doubles at each fix up to the RATE_SLOW_MS heartbeat, so
+ *     parked tags leave the channel to the moving ones and many more tags fit on one channel. If the board has an IMU, RNG_IMU_HOOK can point to
+ *     a function reporting motion; it then decides alone and a tag that starts moving goes back to the fast rate at its next fix.
+ * 22. With RNG_DUTY_CYCLE defined, the DW IC spends the wait between exchanges in DEEPSLEEP instead of IDLE (when the wait is at least
+ *     DW_SLEEP_MIN_MS). dw_sleep_init() (dw_sleep.c) has the configuration and PGF calibration kept in the AON block; on wake-up (SPI chip select)
+ *     dwt_restoreconfig() reloads it, so neither dwt_initialise() nor dwt_configure() with its PLL and RX calibrations is run again. The settings
+ *     applied on top of dwt_configure() are then rewritten by apply_app_config(), a few register writes. The time from the wake-up to the first
+ *     poll sent is accumulated and "WK avg/max ms" is reported every WAKE_REPORT_WAKES wake-ups; the tick is 1 ms, so the average is the useful
+ *     figure. Sleep() only stands for the wait here: on a battery tag the MCU should also enter its own low power mode for that time.
+ * 23. The anchors tune their response delay to their own turnaround (REPLY_TUNE, reply_tune.c in the anchor example) and send the delay in use
+ *     with every response. Before each poll range_exchange() sets the RX after TX delay and RX timeout from the delay the anchor announced
+ *     last, with reply_tune_window(): the window used with the fixed 650 us delay (that of the PHY profile, NOTE 25), moved by the difference
+ *     and widened by REPLY_TUNE_STEP_UUS on each side, the most an anchor changes its delay at a time, so the first response sent with a new
+ *     delay is still received. After a lost response, or with a responder that does not send its delay, the window covers the whole tuning
+ *     range, REPLY_TUNE_MIN_TA_UUS to REPLY_TUNE_MAX_UUS.
+ * 24. Without RNG_PIPELINE, one anchor is ranged per loop iteration and the tag waits between anchors, so a fix needs n_sched waits and the
+ *     distances in it were measured that far apart. With RNG_PIPELINE defined, range_pipeline() ranges all the anchors of the schedule in one
+ *     run, taking them in turn (A1, A2, A3, A1, ...) so that each anchor's burst spans the same time. An exchange is split in three:
+ *     range_poll() sends the poll, range_resp() waits for the response and reads everything that is needed from the DW IC (time-stamps, clock
+ *     offset, CIR diagnostics) before the next TX overwrites it, and range_dist() does the arithmetic on the MCU alone. The next poll is sent
+ *     between range_resp() and range_dist(), so the DW IC is never idle waiting for the MCU and the distance of one anchor is computed while the
+ *     next exchange is on air. A fix takes n_sched * RNG_BURST_LEN exchanges of about 1 ms, and the wait (RNG_DELAY_MS or the rate_ctrl.c
+ *     interval) is taken once per fix instead of once per anchor.
+ * 25. The PHY configuration and the SS-TWR delays come from a named profile (phy_profile.c). PHY_PROFILE_STD is the configuration used so far
+ *     (128 symbol preamble, 6.8 Mbps). PHY_PROFILE_SHORT halves the preamble for dense installations where the range is short: about 715 us per
+ *     exchange instead of 840 us with the 22 byte response. PHY_PROFILE_LONG uses a 1024 symbol preamble at 850 kbps for the sensitivity
+ *     needed at long range, at about 3 ms per exchange. The response delay and RX window of each profile keep the standard profile's margins
+ *     over the longer or shorter preamble and frames. The tag and its anchors must use the same profile; phy_reconfigure() switches at run
+ *     time, keeping the settings of apply_app_config(), and points phy at the new profile before phy_app_config() rewrites the RX delay
+ *     and timeout and forgets the response delays announced in the old one. The tag configures its start-up profile the same way. With PHY_BENCH defined the tag measures each profile at start-up with phy_bench(),
+ *     sending PHY_BENCH_FRAMES polls and responses of the real lengths: "name Xmeas/calc" is the air time of an exchange in us, from the
+ *     measured frames (which include a few us of TX start-up) and from the frame format alone. The highest-throughput profile whose range
+ *     covers a zone is the one to use there.
+ * 26. The installation can be split into zones (zone.c), each on its own UWB channel (5 or 9) and preamble code, so that tags of different
+ *     zones range at the same time without colliding: a different preamble code on the same channel separates zones at some cost in
+ *     cross-interference, and zones on channels 5 and 9 do not interfere at all. anchor_zone[] gives the zone of each anchor (ANCHOR_ZONE in
+ *     the anchor example); the tag ranges only with the anchors of its zone, tag_zone, starting in TAG_ZONE, and moves between zones as in
+ *     NOTE 27. zone_switch() stops TX/RX and, between zones on the same channel, rewrites only the preamble codes in CHAN_CTRL, a single
+ *     register access; a change of channel moves the PLL to another band and the receiver must be recalibrated, so it goes through
+ *     dwt_configure() and the channel's TX spectrum (zone_txrf(), also used by apply_app_config()). The zone table therefore puts the zones
+ *     a tag walks between, zones 0 to 3, all on channel 5 with codes 9 to 12, and every handover and scan takes the fast path; channel 9 is
+ *     for a second group of zones, over another area or doubling the capacity of the same one, and only a move between the two groups
+ *     is slow.
+ * 27. Each anchor sends a beacon every HO_BEACON_MS (handover.c, NOTE 20 of the anchor example). After each fix the tag updates the quality of
+ *     its link, the fraction of the scheduled anchors that answered averaged over a few fixes, and, no more often than HO_SCAN_INTERVAL_MS,
+ *     looks for a better zone: the one whose 3 nearest anchors are on average HO_HYST_M nearer to the position than its own zone's, or, when
+ *     the link drops below HO_LINK_MIN with no such zone, each other zone with anchors in turn. It listens on that zone for one beacon period;
+ *     if HO_MIN_ANCHORS of its anchors are heard at HO_MIN_LEVEL_DBM or more it hands over, otherwise it goes back to its zone. The scan costs
+ *     about HO_SCAN_MS of ranging. The position, the clock offset tracking and the motion rate are kept across the handover, and the first fix
+ *     in the new zone schedules the anchors nearest to the last position, so the track goes on. The anchor the tag left drops it from its
+ *     table after TAG_TABLE_TIMEOUT_MS without a poll.
+ * 28. A tag without a slot (not joined, or no slot free, NOTE 29): with RNG_RANDOM_ACCESS defined it contends for the channel (rand_access.c). Before each run of exchanges
+ *     it listens for RA_CCA_PACS PACs and, if it detects a preamble, backs off a random number of slots and listens again, polling anyway
+ *     after RA_MAX_BUSY busy listens. A run in which no anchor answers within RESP_RX_TIMEOUT_UUS counts as a collision and doubles the
+ *     backoff window, up to 2^RA_EXP_MAX slots of RA_SLOT_MS; a run with an answer resets it. A wait drawn from the window is added to the
+ *     interval between runs, so tags that started together, or that keep colliding on a fixed period, spread out, and as tags come and go
+ *     the window follows the load instead of the collisions growing with it. An anchor out of range also counts as a collision; the first
+ *     answer from another brings the window back. A UWB receiver only detects preambles, so a frame already past its preamble is not seen:
+ *     the backoff still resolves those collisions.
+ * 29. With TAG_JOIN defined the tag joins the network (join.c): at the start of a run, contending like any run while it has no slot, it sends
+ *     a join request with its part ID and waits JOIN_RESP_TO_UUS for the coordinator anchor of its zone (NOTE 21 of the anchor example). The
+ *     response gives it a short address, used from then on in its polls (TAG_ADDR "VE" is only the address before joining), a slot of
+ *     JOIN_SLOT_MS in a cycle of JOIN_CYCLE_MS, or none when all are taken, and a lease of JOIN_LEASE_MS. The slot gives the tag's runs their
+ *     phase, not their rate, which stays RNG_DELAY_MS or the motion's: a tag ranging at most once a cycle runs at the first start of its slot
+ *     after its wait, and neither listens nor backs off; a moving tag ranging more often takes its slot when it falls within the wait and
+ *     contends like a tag without a slot (NOTE 28) for the runs in between. A run must fit in a slot: SEL_ANCHORS x RNG_BURST_LEN exchanges of
+ *     about 1 ms. From JOIN_RENEW_MS on the tag renews the lease in its run, which also brings its slot timing back in step with the
+ *     coordinator; a tag without a slot asks again every cycle. A lease that runs out without being renewed is given up and the tag joins
+ *     again; after a handover (NOTE 27) it joins the new zone's coordinator at once, and the old one reclaims the address and slot when the
+ *     lease ends. Without a coordinator the tag keeps TAG_ADDR and contends, as before.
+ * 30. Each poll carries a new sequence number, poll_sn, and the response must answer it: the anchor echoes the poll's number (NOTE 22 of the
+ *     anchor example), and the response header is compared whole, its source with the poll's destination and its sequence number with the
+ *     poll's. A late response to an earlier poll caught in the RX window of the next, or a response to another tag, is dropped like a
+ *     timeout, so a time-stamp from another exchange never makes a distance and a stale distance never enters a fix. The number is the
+ *     tag's own, so it does not depend on how many other tags an anchor serves; per-sender tracking (seq_track.c) is left to streams with
+ *     one sender, such as the distance frames of the responder example.
+ * 31. A fix combines one range per anchor of the schedule, and those can be far apart in time: without RNG_PIPELINE each anchor is ranged
+ *     in its own run, RNG_DELAY_MS or the adaptive interval apart, so a moving tag's circles do not meet where it is. With RNG_TIME_ALIGN
+ *     defined each range is stamped (range_align.c) with the DW IC system time of the middle of its burst, the poll TX times of its first
+ *     and last exchanges, and with the tick count. Before solving, the ranges are taken to the time of the newest one: those within
+ *     ALIGN_WINDOW_MS of it are used as they are, older ones up to an extrapolation limit are moved along the anchor's range rate
+ *     (smoothed from its previous ranges), and the rest are left out; fewer than 3 left means no fix. With RNG_PIPELINE the limit is
+ *     ALIGN_EXTRAP_MS. Without it the ranges of a fix are whole waits apart, so the limit is n_sched - 1 waits (RNG_DELAY_MS, the adaptive
+ *     interval's share or the slot cycle), each with ALIGN_EXTRAP_MS of margin for the run and a contention backoff: 2.6 s with three
+ *     anchors 1 s apart. The DW IC system time restarts at each wake-up from
+ *     DEEPSLEEP (RNG_DUTY_CYCLE), so each wake-up starts a new epoch and ranges from different epochs are compared on the tick count,
+ *     1 ms resolution, instead. With RNG_PIPELINE all the ranges of a fix fall within a few ms and are used as they are.
  ****************************************************************************************************************************************************/
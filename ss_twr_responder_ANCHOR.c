@@ -23,6 +23,16 @@
 #include <port.h>
 #include <shared_defines.h>
 #include <shared_functions.h>
+#include "ant_cal.h"
+#include "dw_boot.h"
+#include "dw_xfer.h"
+#include "resp_tpl.h"
+#include "reply_tune.h"
+#include "phy_profile.h"
+#include "zone.h"
+#include "handover.h"
+#include "tag_table.h"
+#include "join.h"
 #include "udp_echoclient.h"
 
 #if defined(TEST_SS_TWR_RESPONDER)
@@ -35,36 +45,63 @@ extern void test_run_info(unsigned char *data);
 #define PAN_ID     0xDECA //
 #define SHORT_ADDR 0x3141 /* "A1" (31 = 1, 32 = 2, 33 = 3, 41 = A) 앵커의 주소. x86 CPU는 리틀 엔디언이므로 순서가 바뀜*/
 #define SRC_ADDR   0x4556//0x4556 /* "VE" (56 = V, 45 = E) Source Addr(상대방의 Addr)*/
-/* Default communication configuration. We use default non-STS DW mode. */
-static dwt_config_t config = {
-    5,                /* Channel number. */
-    DWT_PLEN_128,     /* Preamble length. Used in TX only. */
-    DWT_PAC8,         /* Preamble acquisition chunk size. Used in RX only. */
-    9,                /* TX preamble code. Used in TX only. */
-    9,                /* RX preamble code. Used in RX only. */
-    1,                /* 0 to use standard 8 symbol SFD, 1 to use non-standard 8 symbol, 2 for non-standard 16 symbol SFD and 3 for 4z 8 symbol SDF type */
-    DWT_BR_6M8,       /* Data rate. */
-    DWT_PHRMODE_STD,  /* PHY header mode. */
-    DWT_PHRRATE_STD,  /* PHY header rate. */
-    (129 + 8 - 8),    /* SFD timeout (preamble length + 1 + SFD length - PAC size). Used in RX only. */
-    DWT_STS_MODE_OFF, /* STS disabled */
-    DWT_STS_LEN_64,   /* STS length see allowed values in Enum dwt_sts_lengths_e */
-    DWT_PDOA_M0       /* PDOA mode off */
-};
+/* PHY profile (phy_profile.c): preamble length and data rate, with the response delay below to match. The tags must use the same one.
+ * See NOTE 18 below. */
+#define PHY_PROFILE PHY_PROFILE_STD
+static const phy_profile_t *phy = &phy_profiles[PHY_PROFILE];
+/* Communication configuration, the profile's: copied at start-up. */
+static dwt_config_t config;
+
+/* Zone (zone.c) of this anchor: channel and preamble code. See NOTE 19 below. */
+#define ANCHOR_ZONE 0
+
+/* Beacon sent every HO_BEACON_MS for the tags' handover, BEACON_OFS_MS into the period so that the anchors of a zone do not all send at
+ * once. See NOTE 20 below. */
+#define BEACON_OFS_MS (((SHORT_ADDR >> 8) & 0x0F) * 10)
+static uint8_t beacon_frame[HO_BEACON_LEN];
+static uint32_t beacon_due;
+/* Tags served, dropped after TAG_TABLE_TIMEOUT_MS without a poll. */
+static tag_table_t tags;
+static void beacon_send(uint32_t now);
+
+/* Lease addresses and slots to the tags of the zone (join.c). Define on one anchor of each zone. See NOTE 21 below. */
+//#define JOIN_COORDINATOR
+/* First address of the pool: JOIN_MAX_TAGS addresses per zone. */
+#define JOIN_ADDR_BASE (0x5400 + (ANCHOR_ZONE << 8))
+#ifdef JOIN_COORDINATOR
+static join_table_t join;
+static void join_serve(uint16_t frame_len, uint32_t now);
+#endif
+
+/* Frames other than the response (beacon, join response) are written from CTRL_TXBUF_OFS in the TX buffer, so that the response kept at
+ * offset 0 is left alone. */
+#define CTRL_TXBUF_OFS 128
+static uint8_t ctrl_sn = 0;
+static void ctrl_send(uint8_t *frame, uint16_t len);
 
 /* Default antenna delay values for 64 MHz PRF. See NOTE 2 below. */
 #define TX_ANT_DLY 16385
 #define RX_ANT_DLY 16385
+/* Antenna delays in use: the defaults above, or the calibrated values stored in OTP by the antenna delay calibration example. */
+static uint16_t tx_ant_dly = TX_ANT_DLY;
+static uint16_t rx_ant_dly = RX_ANT_DLY;
 
 /* Frames used in the ranging process. See NOTE 3 below. */
-static uint8_t tx_resp_msg[] = { 0x41, 0x88, 0, 0xCA, 0xDE, 'V', 'E', 'W', 'A', 0xE1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+static uint8_t tx_resp_msg[] = { 0x41, 0x88, 0, 0xCA, 0xDE, 'V', 'E', 'W', 'A', 0xE1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
 /* Length of the common part of the message (up to and including the function code, see NOTE 3 below). */
 #define ALL_MSG_COMMON_LEN 10
 /* Index to access some of the fields in the frames involved in the process. */
 #define ALL_MSG_SN_IDX          2
+#define RESP_MSG_DST_IDX        5
+#define RESP_MSG_SRC_IDX        7
+#define POLL_MSG_SRC_IDX        7
 #define RESP_MSG_POLL_RX_TS_IDX 10
 #define RESP_MSG_RESP_TX_TS_IDX 14
 #define RESP_MSG_TS_LEN         4
+#define RESP_MSG_REPLY_DLY_IDX  18
+
+/* Response frame kept in the TX buffer; only the sequence number and time-stamps are rewritten for each poll. See NOTE 16 below. */
+static resp_tpl_t resp_tpl;
 
 
 /* Buffer to store received messages.
@@ -75,8 +112,13 @@ static uint8_t rx_buffer[RX_BUF_LEN];
 /* Hold copy of status register state here for reference so that it can be examined at a debug breakpoint. */
 static uint32_t status_reg = 0;
 
-/* Delay between frames, in UWB microseconds. See NOTE 1 below. */
-#define POLL_RX_TO_RESP_TX_DLY_UUS 650
+/* Delay between frames, in UWB microseconds, 650 in the standard profile. See NOTE 1 below. */
+#define POLL_RX_TO_RESP_TX_DLY_UUS (phy->reply_dly_uus)
+
+/* Tune the response delay to this anchor's turnaround instead of using POLL_RX_TO_RESP_TX_DLY_UUS throughout. See NOTE 17 below. */
+#define REPLY_TUNE
+/* Response delay in use, sent in every response. */
+static reply_tune_t reply_tune;
 
 /* Timestamps of frames transmission/reception. */
 static uint64_t poll_rx_ts;
@@ -87,6 +129,19 @@ static uint64_t resp_tx_ts;
 extern dwt_txconfig_t txconfig_options;
 extern struct netif gnetif;
 
+/* Version of apply_app_config(), part of the warm restart signature: change it when the settings change. See NOTE 14 below. */
+#define APP_CONFIG_SIG 1
+
+static void apply_app_config(void);
+
+/* Count the SPI traffic and time the turnaround of every exchange, reported every SPI_BENCH_EXCHANGES exchanges. See NOTE 15 below. */
+#define SPI_BENCH
+#define SPI_BENCH_EXCHANGES 1000
+
+#ifdef SPI_BENCH
+static dw_xfer_bench_t bench;
+#endif
+
 /*! ------------------------------------------------------------------------------------------------------------------
  * @fn main()
  *
@@ -98,106 +153,155 @@ extern struct netif gnetif;
  */
 int ss_twr_responder(void)
 {
+    dw_boot_times_t bt;
+    char boot_str[32];
+
     /* Display application name on LCD. */
     test_run_info((unsigned char *)APP_NAME);
 
     /* Configure SPI rate, DW3000 supports up to 36 MHz */
     port_set_dw_ic_spi_fastrate();
 
-    /* Reset and initialize DW chip. */
-    reset_DWIC(); /* Target specific drive of RSTn line into DW3000 low for a period. */
+    /* Route the driver's SPI transfers through the counting (and optionally DMA) transport. See NOTE 15 below. */
+    dw_xfer_init();
 
-    Sleep(2); // Time needed for DW3000 to start up (transition from INIT_RC to IDLE_RC, or could wait for SPIRDY event)
+    /* Start from the fixed response delay; the delay in use is part of the response loaded by apply_app_config(). See NOTE 17 below. */
+    reply_tune_init(&reply_tune, POLL_RX_TO_RESP_TX_DLY_UUS, PHY_REPLY_OFS_UUS(phy), (uint16_t)phy_shr_us(&phy->config));
+    tx_resp_msg[RESP_MSG_REPLY_DLY_IDX] = (uint8_t)reply_tune.dly_uus;
+    tx_resp_msg[RESP_MSG_REPLY_DLY_IDX + 1] = (uint8_t)(reply_tune.dly_uus >> 8);
 
-    /* Probe for the correct device driver. */
-    dwt_probe((struct dwt_probe_s *)&dw3000_probe_interf);
+    config = phy->config;
+    zone_apply(&config, ANCHOR_ZONE);
 
-    while (!dwt_checkidlerc()) /* Need to make sure DW IC is in IDLE_RC before proceeding */ { };
-    if (dwt_initialise(DWT_DW_INIT) == DWT_ERROR)
+    /* Bring the DW IC up: warm restart when it kept its configuration through an MCU reset, full reset and configuration otherwise.
+     * See NOTE 14 below. */
+    if (dw_boot(&dw_xfer_probe_interf, &config, apply_app_config, APP_CONFIG_SIG, &bt) == DWT_ERROR)
     {
         test_run_info((unsigned char *)"INIT FAILED     ");
         while (1) { };
     }
 
-    /* Enabling LEDs here for debug so that for each TX the D1 LED will flash on DW3000 red eval-shield boards. */
-    dwt_setleds(DWT_LEDS_ENABLE | DWT_LEDS_INIT_BLINK);
+    /* Report the start-up path and the time spent in each step. */
+    snprintf(boot_str, sizeof(boot_str), "%s %lu %s", bt.warm ? "WARM" : "COLD", (unsigned long)bt.total, DW_BOOT_TICK_UNIT);
+    test_run_info((unsigned char *)boot_str);
+    snprintf(boot_str, sizeof(boot_str), "R%lu P%lu I%lu C%lu A%lu", (unsigned long)bt.reset, (unsigned long)bt.probe, (unsigned long)bt.init,
+             (unsigned long)bt.config, (unsigned long)bt.app);
+    test_run_info((unsigned char *)boot_str);
 
-    /* Configure DW IC. See NOTE 13 below. */
-    /* if the dwt_configure returns DWT_ERROR either the PLL or RX calibration has failed the host should reset the device */
-    if (dwt_configure(&config))
-    {
-        test_run_info((unsigned char *)"CONFIG FAILED     ");
-        while (1) { };
-    }
-
-    /* Configure the TX spectrum parameters (power, PG delay and PG count) */
-    dwt_configuretxrf(&txconfig_options);
-
-    /* Apply default antenna delay value. See NOTE 2 below. */
-    dwt_setrxantennadelay(RX_ANT_DLY);
-    dwt_settxantennadelay(TX_ANT_DLY);
-
-    /* Next can enable TX/RX states output on GPIOs 5 and 6 to help debug, and also TX/RX LEDs
-     * Note, in real low power applications the LEDs should not be used. */
-    dwt_setlnapamode(DWT_LNA_ENABLE | DWT_PA_ENABLE);
+#ifdef SPI_BENCH
+    dw_xfer_bench_reset(&bench);
+#endif
 
-    /* 기본 주소 설정 */
-    dwt_setpanid(PAN_ID);
-    dwt_setaddress16(SHORT_ADDR);
     /* 자동 ACK 설정. (첫 번째 매개변수는 ACK 딜레이 시간. 0이므로 a.s.a.p) */
     //dwt_enableautoack(0, 1);
 
+    tag_table_init(&tags);
+    beacon_due = portGetTickCnt() + BEACON_OFS_MS;
+#ifdef JOIN_COORDINATOR
+    join_table_init(&join, JOIN_ADDR_BASE, portGetTickCnt());
+#endif
+
     /* Loop forever responding to ranging requests. */
     while (1)
     {
-        dwt_configureframefilter(DWT_FF_ENABLE_802_15_4, DWT_FF_MAC_LE2_EN); // 프레임 필터링 기능 사용 (802.15.4 프로토콜, LE2_PEND의 주소가 source addr과 일치할 때)
-        dwt_configure_le_address(SRC_ADDR, LE2);                             //
+        uint32_t now = portGetTickCnt();
+
+        /* Send the beacon when due, and listen for polls until the next one. See NOTE 20 below. */
+        if ((int32_t)(beacon_due - now) <= 0)
+        {
+            beacon_send(now);
+            beacon_due += HO_BEACON_MS;
+            if ((int32_t)(beacon_due - now) <= 0)
+                beacon_due = now + HO_BEACON_MS;
+        }
+        dwt_setrxtimeout((beacon_due - now) * 1000);
+
         memset(rx_buffer, 0, sizeof(rx_buffer));
 
         /* Activate reception immediately. */
         dwt_rxenable(DWT_START_RX_IMMEDIATE);
 
         /* Poll for reception of a frame or error/timeout. See NOTE 6 below. */
-        waitforsysstatus(&status_reg, NULL, (DWT_INT_RXFCG_BIT_MASK | SYS_STATUS_ALL_RX_ERR), 0);
+        waitforsysstatus(&status_reg, NULL, (DWT_INT_RXFCG_BIT_MASK | SYS_STATUS_ALL_RX_TO | SYS_STATUS_ALL_RX_ERR), 0);
 
         if (status_reg & DWT_INT_RXFCG_BIT_MASK)
         {
             uint16_t frame_len;
+            uint32_t clear_events = DWT_INT_RXFCG_BIT_MASK;
 
-            /* Clear good RX frame event in the DW IC status register. */
-            dwt_writesysstatuslo(DWT_INT_RXFCG_BIT_MASK);
+#ifdef SPI_BENCH
+            dw_xfer_bench_start(&bench);
+#endif
 
-            /* A frame has been received, read it into the local buffer. */
+            /* Only what the response needs is done before the delayed TX is started: clearing the events and reading the poll come after.
+             * See NOTE 15 below. */
             frame_len = dwt_getframelength();
+            /* Beacons and join requests are broadcast and pass the frame filter: longer than a poll, they are not answered. See NOTE 20
+             * below. */
             if (frame_len <= sizeof(rx_buffer))
             {
 				uint32_t resp_tx_time;
 				int ret;
-                dwt_readrxdata(rx_buffer, frame_len, 0);
-
-                /* Check that the frame is a poll sent by "SS TWR initiator" example.
-                 * As the sequence number field of the frame is not relevant, it is cleared to simplify the validation of the frame. */
-                //rx_buffer[ALL_MSG_SN_IDX] = 0;
+#ifdef REPLY_TUNE
+				uint32_t tx_start_hi32;
+#endif
 
 				/* Retrieve poll reception timestamp. */
 				poll_rx_ts = get_rx_timestamp_u64();
 
 				/* Compute response message transmission time. See NOTE 7 below. */
-				resp_tx_time = (poll_rx_ts + (POLL_RX_TO_RESP_TX_DLY_UUS * UUS_TO_DWT_TIME)) >> 8;
+				resp_tx_time = (poll_rx_ts + ((uint64_t)reply_tune.dly_uus * UUS_TO_DWT_TIME)) >> 8;
 				dwt_setdelayedtrxtime(resp_tx_time);
 
 				/* Response TX timestamp is the transmission time we programmed plus the antenna delay. */
-				resp_tx_ts = (((uint64_t)(resp_tx_time & 0xFFFFFFFEUL)) << 8) + TX_ANT_DLY;
+				resp_tx_ts = (((uint64_t)(resp_tx_time & 0xFFFFFFFEUL)) << 8) + tx_ant_dly;
 
 				/* Write all timestamps in the final message. See NOTE 8 below. */
 				resp_msg_set_ts(&tx_resp_msg[RESP_MSG_POLL_RX_TS_IDX], poll_rx_ts);
 				resp_msg_set_ts(&tx_resp_msg[RESP_MSG_RESP_TX_TS_IDX], resp_tx_ts);
 
-				/* Write and send the response message. See NOTE 9 below. */
-				//tx_resp_msg[ALL_MSG_SN_IDX] = frame_seq_nb;
-				dwt_writetxdata(sizeof(tx_resp_msg), tx_resp_msg, 0); /* Zero offset in TX buffer. */
-				dwt_writetxfctrl(sizeof(tx_resp_msg), 0, 1);          /* Zero offset in TX buffer, ranging. */
+				/* Echo the poll's sequence number and address the response to the tag that polled, joined tags each having their own
+				 * address: one read of the poll's bytes 2 to 8. See NOTE 21 and 22 below. */
+				{
+					uint8_t poll_hdr[POLL_MSG_SRC_IDX + 2 - ALL_MSG_SN_IDX];
+
+					dwt_readrxdata(poll_hdr, sizeof(poll_hdr), ALL_MSG_SN_IDX);
+					tx_resp_msg[ALL_MSG_SN_IDX] = poll_hdr[0];
+					tx_resp_msg[RESP_MSG_DST_IDX] = poll_hdr[POLL_MSG_SRC_IDX - ALL_MSG_SN_IDX];
+					tx_resp_msg[RESP_MSG_DST_IDX + 1] = poll_hdr[POLL_MSG_SRC_IDX + 1 - ALL_MSG_SN_IDX];
+				}
+
+				/* Patch the changed fields into the response already in the TX buffer and send it. See NOTE 9 and 16 below. */
+				resp_tpl_dirty(&resp_tpl, ALL_MSG_SN_IDX, 1);
+				resp_tpl_dirty(&resp_tpl, RESP_MSG_DST_IDX, 2);
+				resp_tpl_dirty(&resp_tpl, RESP_MSG_POLL_RX_TS_IDX, 2 * RESP_MSG_TS_LEN);
+				resp_tpl_flush(&resp_tpl);
+#ifdef SPI_BENCH
+				dw_xfer_bench_tx(&bench, poll_rx_ts);
+#endif
 				ret = dwt_starttx(DWT_START_TX_DELAYED);
+#ifdef REPLY_TUNE
+				/* End of the turnaround, before the poll is read. See NOTE 17 below. */
+				tx_start_hi32 = dwt_readsystimestamphi32();
+#endif
+
+				/* The response is on its way: read the poll now. */
+				dwt_readrxdata(rx_buffer, frame_len, 0);
+				tag_table_seen(&tags, rx_buffer[POLL_MSG_SRC_IDX] | (rx_buffer[POLL_MSG_SRC_IDX + 1] << 8), now);
+
+#ifdef REPLY_TUNE
+				/* Account for the turnaround or the late TX; a new delay is sent from the next response on. See NOTE 17 below. */
+				if (reply_tune_tx(&reply_tune, poll_rx_ts, tx_start_hi32, ret != DWT_SUCCESS))
+				{
+					tx_resp_msg[RESP_MSG_REPLY_DLY_IDX] = (uint8_t)reply_tune.dly_uus;
+					tx_resp_msg[RESP_MSG_REPLY_DLY_IDX + 1] = (uint8_t)(reply_tune.dly_uus >> 8);
+					resp_tpl_dirty(&resp_tpl, RESP_MSG_REPLY_DLY_IDX, 2);
+				}
+#endif
+
+				/* Check that the frame is a poll sent by "SS TWR initiator" example.
+				 * As the sequence number field of the frame is not relevant, it is cleared to simplify the validation of the frame. */
+				//rx_buffer[ALL_MSG_SN_IDX] = 0;
 
 				/* If dwt_starttx() returns an error, abandon this ranging exchange and proceed to the next one. See NOTE 10 below. */
 				if (ret == DWT_SUCCESS)
@@ -205,18 +309,44 @@ int ss_twr_responder(void)
 					/* Poll DW IC until TX frame sent event set. See NOTE 6 below. */
 					waitforsysstatus(NULL, NULL, DWT_INT_TXFRS_BIT_MASK, 0);
 
-					/* Clear TXFRS event. */
-					dwt_writesysstatuslo(DWT_INT_TXFRS_BIT_MASK);
-
-					/* Increment frame sequence number after transmission of the poll message (modulo 256). */
-					//frame_seq_nb++;
+					/* TXFRS is cleared with RXFCG below. */
+					clear_events |= DWT_INT_TXFRS_BIT_MASK;
+				}
+#ifdef SPI_BENCH
+				else
+				{
+					bench.late++;
 				}
+#endif
+            }
+#ifdef JOIN_COORDINATOR
+            else if (frame_len == JOIN_REQ_LEN)
+            {
+                join_serve(frame_len, now);
             }
+#endif
+
+            /* Clear the RX (and TX) events in one write. */
+            dwt_writesysstatuslo(clear_events);
+
+#ifdef SPI_BENCH
+            if (bench.n >= SPI_BENCH_EXCHANGES)
+            {
+                char bench_str[32];
+
+                snprintf(bench_str, sizeof(bench_str), "SPI %lu txn %lu B", (unsigned long)(bench.txn / bench.n), (unsigned long)(bench.bytes / bench.n));
+                test_run_info((unsigned char *)bench_str);
+                snprintf(bench_str, sizeof(bench_str), "TA %lu/%lu us L%lu D%u", (unsigned long)(bench.ta_sum / bench.n / DW_XFER_TICKS_PER_US),
+                         (unsigned long)(bench.ta_max / DW_XFER_TICKS_PER_US), (unsigned long)bench.late, reply_tune.dly_uus);
+                test_run_info((unsigned char *)bench_str);
+                dw_xfer_bench_reset(&bench);
+            }
+#endif
         }
         else
         {
-            /* Clear RX error events in the DW IC status register. */
-            dwt_writesysstatuslo(SYS_STATUS_ALL_RX_ERR);
+            /* Clear RX error/timeout events in the DW IC status register. */
+            dwt_writesysstatuslo(SYS_STATUS_ALL_RX_TO | SYS_STATUS_ALL_RX_ERR);
         }
 
 
@@ -249,6 +379,116 @@ int ss_twr_responder(void)
 		//udp_echoclient_send();
     }
 }
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn beacon_send()
+ *
+ * @brief Drop the tags gone quiet and send the beacon with the number of tags left. See NOTE 20 below.
+ *
+ * @param  now  tick count
+ *
+ * @return none
+ */
+static void beacon_send(uint32_t now)
+{
+    int n = tag_table_expire(&tags, now);
+
+#ifdef JOIN_COORDINATOR
+    /* Reclaim the leases not renewed. */
+    join_table_expire(&join, now);
+#endif
+    ho_beacon_build(beacon_frame, ctrl_sn++, SHORT_ADDR, ANCHOR_ZONE, (uint8_t)((n > 255) ? 255 : n));
+    ctrl_send(beacon_frame, sizeof(beacon_frame));
+}
+
+#ifdef JOIN_COORDINATOR
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn join_serve()
+ *
+ * @brief Answer a join request at once with the tag's address, slot and lease. See NOTE 21 below.
+ *
+ * @param  frame_len  length of the request received
+ * @param  now        tick count
+ *
+ * @return none
+ */
+static void join_serve(uint16_t frame_len, uint32_t now)
+{
+    uint8_t req[JOIN_REQ_LEN], resp[JOIN_RESP_LEN];
+    int len;
+
+    dwt_readrxdata(req, frame_len, 0);
+    len = join_table_request(&join, req, frame_len, ctrl_sn, SHORT_ADDR, now, resp);
+    if (len > 0)
+    {
+        ctrl_sn++;
+        ctrl_send(resp, (uint16_t)len);
+    }
+}
+#endif
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn ctrl_send()
+ *
+ * @brief Send a frame at once from CTRL_TXBUF_OFS and point the TX frame control back at the response template.
+ *
+ * @param  frame  frame, the 2 checksum bytes included in len
+ * @param  len    frame length
+ *
+ * @return none
+ */
+static void ctrl_send(uint8_t *frame, uint16_t len)
+{
+    dwt_writetxdata(len, frame, CTRL_TXBUF_OFS);
+    dwt_writetxfctrl(len, CTRL_TXBUF_OFS, 0); /* No ranging. */
+    if (dwt_starttx(DWT_START_TX_IMMEDIATE) == DWT_SUCCESS)
+    {
+        waitforsysstatus(NULL, NULL, DWT_INT_TXFRS_BIT_MASK, 0);
+        dwt_writesysstatuslo(DWT_INT_TXFRS_BIT_MASK);
+    }
+
+    /* Point the TX frame control back at the response. */
+    dwt_writetxfctrl(sizeof(tx_resp_msg), 0, 1); /* Zero offset in TX buffer, ranging. */
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn apply_app_config()
+ *
+ * @brief Settings applied on top of dwt_configure(), after a cold start and after a warm restart. See NOTE 14 below.
+ *
+ * @param  none
+ *
+ * @return none
+ */
+static void apply_app_config(void)
+{
+    /* Configure the TX spectrum parameters (power, PG delay and PG count) */
+    dwt_configuretxrf(zone_txrf(config.chan));
+
+    /* Apply calibrated antenna delay value if one is stored in OTP, default value otherwise. See NOTE 2 below. */
+    ant_cal_load(&tx_ant_dly, &rx_ant_dly);
+    dwt_setrxantennadelay(rx_ant_dly);
+    dwt_settxantennadelay(tx_ant_dly);
+
+    /* Next can enable TX/RX states output on GPIOs 5 and 6 to help debug, and also TX/RX LEDs
+     * Note, in real low power applications the LEDs should not be used. */
+    dwt_setlnapamode(DWT_LNA_ENABLE | DWT_PA_ENABLE);
+
+    /* 기본 주소 설정 */
+    dwt_setpanid(PAN_ID);
+    dwt_setaddress16(SHORT_ADDR);
+
+    /* Frame filter: polls (MAC command frames) and join requests and beacons (data frames) addressed to this anchor or broadcast, from any
+     * source, as joined tags poll from their leased addresses. See NOTE 21 below. */
+    dwt_configureframefilter(DWT_FF_ENABLE_802_15_4, DWT_FF_DATA_EN | DWT_FF_MAC_EN);
+
+    /* Respond from this anchor's own address: the tags check that the anchor polled is the one answering. See NOTE 22 below. */
+    tx_resp_msg[RESP_MSG_SRC_IDX] = (uint8_t)SHORT_ADDR;
+    tx_resp_msg[RESP_MSG_SRC_IDX + 1] = (uint8_t)(SHORT_ADDR >> 8);
+
+    /* Load the whole response and its TX frame control once; each poll then only patches it. See NOTE 15 and 16 below. */
+    resp_tpl_load(&resp_tpl, tx_resp_msg, sizeof(tx_resp_msg), 1); /* Zero offset in TX buffer, ranging. */
+}
 #endif
 /*****************************************************************************************************************************************************
  * NOTES:
@@ -290,6 +530,7 @@ int ss_twr_responder(void)
  *    Response message:
  *     - byte 10 -> 13: poll message reception timestamp.
  *     - byte 14 -> 17: response message transmission timestamp.
+ *     - byte 18/19: response delay in UWB microseconds, see NOTE 17 below.
  *    All messages end with a 2-byte checksum automatically set by DW IC.
  * 4. Source and destination addresses are hard coded constants in this example to keep it simple but for a real product every device should have a
  *    unique ID. Here, 16-bit addressing is used to keep the messages as short as possible but, in an actual application, this should be done only
@@ -323,4 +564,63 @@ int ss_twr_responder(void)
  *     thereafter.
  * 13. Desired configuration by user may be different to the current programmed configuration. dwt_configure is called to set desired
  *     configuration.
+ * 14. dw_boot() (dw_boot.c) replaces the reset / probe / dwt_initialise() / dwt_configure() sequence. After a cold start it writes a signature of
+ *     the configuration (config and APP_CONFIG_SIG) into the DW IC scratch RAM. After an MCU-only reset (watchdog, debugger) the DW IC is still
+ *     running with that configuration: if the signature matches and the system time is counting, the DW IC is not reset and dwt_configure(),
+ *     with its PLL and RX calibrations, is skipped; the calibration results are still in its registers. Only dwt_initialise() (driver state and
+ *     OTP values), stopping any TX/RX left over and apply_app_config() are run, which brings an anchor back in a few milliseconds. The start-up
+ *     path, total time and time of each step (R reset, P probe, I initialise, C configure, A application settings) are reported; the unit is
+ *     DW_BOOT_TICK_UNIT, and a board with a microsecond timer can define DW_BOOT_TICK() to resolve the warm steps.
+ * 15. The time between the poll RX and the delayed TX start is what bounds POLL_RX_TO_RESP_TX_DLY_UUS, and it is mostly SPI transactions. Only
+ *     the frame length check, the poll RX time-stamp read, the delayed TX time, the response data and the TX start are left in it: the TX frame
+ *     control and the frame filter settings never change and are written once in apply_app_config(), the poll is read after the TX is started
+ *     and the RX and TX events are cleared together in one write at the end. All SPI traffic goes through dw_xfer.c, which counts it; with
+ *     DW_XFER_DMA defined, transfers of DW_XFER_DMA_MIN bytes or more use the board's port_spi_dma_read()/port_spi_dma_write(). With SPI_BENCH
+ *     defined, every SPI_BENCH_EXCHANGES exchanges the average SPI transactions and bytes of that window ("SPI n txn n B") and the average and
+ *     longest turnaround with the number of late TX ("TA avg/max us Ln") are reported. POLL_RX_TO_RESP_TX_DLY_UUS can be brought down to the
+ *     longest turnaround plus a margin while L stays at 0 (with REPLY_TUNE defined this is done at run time, D is the delay in use).
+ * 16. The response is written whole to the TX buffer once, by resp_tpl_load() (resp_tpl.c) in apply_app_config(); the DW IC keeps the TX buffer
+ *     content after each transmission. For each poll only the sequence number and the two time-stamps change: they are updated in tx_resp_msg,
+ *     marked with resp_tpl_dirty() and written back by resp_tpl_flush() as a single offset write of the range they span (bytes 2 to 17, the
+ *     unchanged PAN ID, addresses and function code in between are cheaper to rewrite than a second transaction). Anything else sent from this
+ *     TX buffer offset would require resp_tpl_load() again before the next response.
+ * 17. A late dwt_starttx() loses the exchange (NOTE 10) and costs the tag a full RX timeout, while a needlessly long response delay costs air
+ *     time and, in SS-TWR, accuracy (the clock offset error grows with it). With REPLY_TUNE defined, reply_tune_tx() (reply_tune.c) is called
+ *     after every TX start with the system time read right after dwt_starttx(): the turnaround is measured from the poll RX time-stamp to that
+ *     read, so reading the poll and the bookkeeping done once the response is on its way do not count. It keeps a histogram of the turnaround,
+ *     and every REPLY_TUNE_WINDOW exchanges moves the delay towards the REPLY_TUNE_QUANT_PERMIL quantile of the turnaround plus the response's
+ *     SHR (preamble and SFD, phy_shr_us()) and REPLY_TUNE_MARGIN_UUS: the delay sets the RMARKER time, and the SHR must already be on air by
+ *     then. It stays within REPLY_TUNE_MIN_TA_UUS plus the SHR to REPLY_TUNE_MAX_UUS; a late TX raises it by REPLY_TUNE_STEP_UUS at once and
+ *     holds it for the window. The delay in use is sent in the last two bytes of the response (RESP_MSG_REPLY_DLY_IDX, little endian, UWB
+ *     microseconds) and the tag opens its RX window around it. As the delay never moves by more than REPLY_TUNE_STEP_UUS at a time and the
+ *     tag's window is widened by that much, the tag still receives the first response sent with a new delay and follows it; a tag that loses
+ *     track falls back to a window covering the whole range.
+ * 18. The PHY configuration and the response delay come from a named profile (phy_profile.c, see NOTE 25 of the tag example), the same on the
+ *     anchors and the tag. With a profile other than PHY_PROFILE_STD the highest REPLY_TUNE delay moves by PHY_REPLY_OFS_UUS(), the difference
+ *     of the response delays, and the target and lowest delay follow the profile's SHR, passed to reply_tune_init(). The profile is part of
+ *     config and so of the warm restart signature; a device switching profile at run time passes phy_reconfigure() its profile pointer, which
+ *     is set to the new profile, and a settings function that calls reply_tune_init() with the new delays and rewrites the response delay
+ *     field, then calls dw_boot_invalidate().
+ * 19. The anchor runs in the zone ANCHOR_ZONE (zone.c): its channel and preamble code are set in config before dw_boot(), so they are part of
+ *     the warm restart signature, and the TX spectrum is the one for the channel. Only the tags of that zone reach it (see NOTE 26 of the
+ *     tag example); anchors of zones on different channels or codes cover the same area without sharing air time.
+ * 20. For the tags' zone handover (handover.c, NOTE 27 of the tag example) the anchor sends a beacon every HO_BEACON_MS: broadcast, with its
+ *     zone and the number of tags it serves. The poll RX is given a timeout up to the next beacon, one register write per loop outside the
+ *     exchange. The beacon is written at CTRL_TXBUF_OFS in the TX buffer and the frame control is pointed back at offset 0 afterwards, so the
+ *     response template (NOTE 16) is not reloaded. Each poll records its tag in a table (tag_table.c); a tag silent for TAG_TABLE_TIMEOUT_MS,
+ *     gone to another zone or off, is dropped when the next beacon is sent, so the state kept per tag stays bounded and current. The beacons of the
+ *     neighbouring anchors of the same zone are received too; being longer than a poll they are not answered.
+ * 21. With JOIN_COORDINATOR defined the anchor leases addresses and slots to the tags of its zone (join.c, NOTE 29 of the tag example): one
+ *     anchor per zone, each zone with its own pool of JOIN_MAX_TAGS addresses from JOIN_ADDR_BASE. A join request is answered at once, from
+ *     the RX loop; leases not renewed within JOIN_LEASE_MS are reclaimed, address and slot, when the next beacon is sent. The slot cycle
+ *     starts when the coordinator starts and the response tells the tag how long until its slot, so the tags need no other time reference.
+ *     As tags now have addresses of their own, each response is addressed to the source of its poll: two bytes read from the RX buffer
+ *     before the response is started and flushed with the other changed fields, in the same write. The frame filter takes data frames, as the
+ *     join requests are, and MAC command frames from any source instead of from "VE" only (SRC_ADDR, the LE2 match of the other
+ *     responders): the tags' addresses come from the lease pool. The pool and the slot count bound the state an anchor keeps
+ *     for the tags: TAG_TABLE_LEN (tag_table.c) can be sized from JOIN_SLOTS.
+ * 22. The response carries this anchor's address, SHORT_ADDR, as its source instead of the "WA" of the template, and the sequence number of
+ *     the poll it answers. The tag only uses a response to its last poll (NOTE 30 of the tag example). A counter of the anchor's own would be
+ *     shared by all the tags it serves and jump between two exchanges of the same tag; the poll's number, read in the same transaction as
+ *     its source, costs no extra SPI transaction before the TX start.
  ****************************************************************************************************************************************************/
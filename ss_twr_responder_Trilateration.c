@@ -23,6 +23,13 @@
 #include <port.h>
 #include <shared_defines.h>
 #include <shared_functions.h>
+#include "ant_cal.h"
+#include "trilateration.h"
+#include "report_agg.h"
+#include "bulk_xfer.h"
+#include "mesh_relay.h"
+#include "seq_track.h"
+#include "range_align.h"
 
 #if defined(TEST_SS_TWR_RESPONDER)
 
@@ -51,6 +58,9 @@ static dwt_config_t config = {
 /* Default antenna delay values for 64 MHz PRF. See NOTE 2 below. */
 #define TX_ANT_DLY 16385
 #define RX_ANT_DLY 16385
+/* Antenna delays in use: the defaults above, or the calibrated values stored in OTP by the antenna delay calibration example. */
+static uint16_t tx_ant_dly = TX_ANT_DLY;
+static uint16_t rx_ant_dly = RX_ANT_DLY;
 
 /* Frames used in the ranging process. See NOTE 3 below. */
 /* ---------------------앵커 1 --------------------------------------------------------------*/
@@ -78,7 +88,12 @@ static uint8_t frame_seq_nb3 = 0;
  * Its size is adjusted to longest frame that this example code is supposed to handle. */
 #define RX_BUF_LEN 12 // Must be less than FRAME_LEN_MAX_EX
 static uint8_t rx_buffer[RX_BUF_LEN];
-static uint8_t buff[16] = {0, };
+/* Distance frame sent by the initiator after each exchange: the poll's header with function code DIST_MSG_FCODE and the sender's own
+ * sequence number, then the distance as text up to the checksum. See NOTE 18 below. */
+#define DIST_MSG_FCODE   0xE9
+#define DIST_MSG_TXT_IDX 10
+#define DIST_MSG_LEN     20
+static uint8_t buff[DIST_MSG_LEN] = {0, };
 /*
 static uint8_t anchor1[16] = {'A','1',':',0,0,0,0,0,0,0,0,0,0,0,0, 10};
 static uint8_t anchor2[16] = {'A','2',':',0,0,0,0,0,0,0,0,0,0,0,0, 10};
@@ -108,43 +123,188 @@ float str_to_float(char *arr){
     val = val*pow(10,j);
     return val;
 }
-typedef struct Anchor
-{
-	float x;
-	float y;
-	float distance;
-}Anchor;
 
 unsigned char arr1[16] = {'X',':',0,0,0,0,0,0,0,0};
 unsigned char arr2[16] = {'Y',':',0,0,0,0,0,0,0,0};
+
+/* Positions are sent to the gateway ("A4", see simple_rx.c) in aggregated report frames. The tag positioned here is this device ("WA"): its
+ * records carry its address and are numbered by report_seq. See NOTE 15 below. */
+#define REPORT_GATEWAY_ADDR 0x3441
+#define REPORT_OWN_ADDR     0x4157
+static report_agg_t report;
+static uint8_t report_seq = 0;
+
+/* Send the reports in extended frames (bulk_xfer.c), up to REPORT_AGG_RECS(BULK_CHUNK_MAX) positions per frame. Only worth it for an
+ * anchor producing more than 11 positions per REPORT_AGG_MAX_AGE_MS. See NOTE 16 below. */
+//#define REPORT_BULK
+
+/* Anchor out of the gateway's range: relay the reports over the other anchors (mesh_relay.c) instead, in this anchor's TDMA slot. Takes
+ * precedence over REPORT_BULK. See NOTE 17 below. */
+//#define REPORT_MESH
+#define MESH_PARENT_ADDR REPORT_GATEWAY_ADDR
+#define MESH_OWN_SLOT    1
+#ifdef REPORT_MESH
+static uint8_t mesh_buf[127];
+#endif
+
+#if defined(REPORT_MESH)
+#define REPORT_BUF_LEN MESH_PAYLOAD_MAX
+#elif defined(REPORT_BULK)
+#define REPORT_BUF_LEN BULK_CHUNK_MAX
+#else
+#define REPORT_BUF_LEN REPORT_AGG_FRAME_MAX
+#endif
+static uint8_t report_buf[REPORT_BUF_LEN];
+
+/* Reports and dumps are sent once the channel has been quiet, no frame received, for this long: between exchanges, not in the middle of
+ * one. Also the gap between chunks. See NOTE 16 below. */
+#define IDLE_LISTEN_UUS (BULK_CHUNK_GAP_MS * 1000)
+
+/* Every DIAG_DUMP_FIXES fixes, send the first DIAG_DUMP_TAPS taps of the CIR of the last frame received to the gateway. See NOTE 16 below. */
+#define DIAG_DUMP
+#define DIAG_DUMP_FIXES 100
+#define DIAG_DUMP_TAPS  256
+#ifdef DIAG_DUMP
+/* One dummy byte, then 3 bytes real and 3 bytes imaginary per tap. */
+static uint8_t diag_buf[1 + DIAG_DUMP_TAPS * 6];
+static int diag_fixes = 0;
+static bulk_tx_t diag_tx;
+#endif
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn report_position()
+ *
+ * @brief Add a position to the aggregated report. It is sent from idle time by idle_send(), or queued for the parent here with REPORT_MESH.
+ *        See NOTE 15 below.
+ *
+ * @param  set  anchors and distances the position was computed from
+ * @param  n    number of anchors
+ * @param  pos  position
+ *
+ * @return none
+ */
+static void report_position(const Anchor *set, int n, const Position *pos)
+{
+    report_rec_t rec;
+    double sq = 0.0, r;
+    uint32_t now = portGetTickCnt();
+    int i;
+
+    /* Quality from the RMS range residual: 255 for a perfect fit, 0 from 2.55 m. */
+    for (i = 0; i < n; i++)
+    {
+        r = sqrt((pos->x - set[i].x) * (pos->x - set[i].x) + (pos->y - set[i].y) * (pos->y - set[i].y)) - set[i].distance;
+        sq += r * r;
+    }
+    r = sqrt(sq / n) * 100.0;
+    rec.quality = (r >= 255.0) ? 0 : (uint8_t)(255.0 - r);
+    rec.id = REPORT_OWN_ADDR;
+    rec.seq = report_seq++;
+    rec.x_cm = (int16_t)(pos->x * 100.0);
+    rec.y_cm = (int16_t)(pos->y * 100.0);
+    rec.z_cm = (int16_t)(pos->z * 100.0);
+    report_agg_add(&report, &rec, now);
+
+#ifdef DIAG_DUMP
+    /* The CIR is that of the last frame: read it now, send it from idle time. A dump still being sent is not replaced. */
+    if (++diag_fixes >= DIAG_DUMP_FIXES && !diag_tx.active)
+    {
+        diag_fixes = 0;
+        dwt_readaccdata(diag_buf, sizeof(diag_buf), 0);
+        bulk_tx_start(&diag_tx, REPORT_GATEWAY_ADDR, REPORT_OWN_ADDR, BULK_TYPE_DIAG, &diag_buf[1], sizeof(diag_buf) - 1);
+    }
+#endif
+
+#if defined(REPORT_MESH)
+    if (report_agg_due(&report, now))
+    {
+        uint16_t len = report_agg_take(&report);
+
+        mesh_send(report.frame, len);
+    }
+#endif
+}
+
+#ifndef REPORT_MESH
+/* Something to send from idle time. */
+static int idle_pending(void)
+{
+    if (report.n > 0)
+        return 1;
+#ifdef DIAG_DUMP
+    if (diag_tx.active)
+        return 1;
+#endif
+    return 0;
+}
+#endif
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn idle_send()
+ *
+ * @brief Called when the channel has been quiet for IDLE_LISTEN_UUS: send one frame, the report if it is due, else the next chunk of the
+ *        diagnostics dump, so that the loop is back listening for polls after one frame. See NOTE 16 below.
+ *
+ * @param  none
+ *
+ * @return none
+ */
+static void idle_send(void)
+{
+#ifndef REPORT_MESH
+    if (report_agg_due(&report, portGetTickCnt()))
+    {
+        uint16_t len = report_agg_take(&report);
+
+#if defined(REPORT_BULK)
+        /* The report buffer holds one chunk: one frame. */
+        bulk_send(REPORT_GATEWAY_ADDR, REPORT_OWN_ADDR, BULK_TYPE_REPORT, report.frame, len);
+#else
+        dwt_writetxdata(len, report.frame, 0); /* Zero offset in TX buffer. */
+        dwt_writetxfctrl(len, 0, 0);           /* Zero offset in TX buffer, no ranging. */
+        if (dwt_starttx(DWT_START_TX_IMMEDIATE) == DWT_SUCCESS)
+        {
+            waitforsysstatus(NULL, NULL, DWT_INT_TXFRS_BIT_MASK, 0);
+            dwt_writesysstatuslo(DWT_INT_TXFRS_BIT_MASK);
+        }
+#endif
+        return;
+    }
+#endif
+#ifdef DIAG_DUMP
+    if (diag_tx.active)
+        bulk_tx_chunk(&diag_tx);
+#endif
+}
 //static double Tag_x[4]={0,};
 //static double Tag_y[4]={0,};
-void trilaterate(Anchor A1, Anchor A2, Anchor A3)
+/* Position from the three anchors, refined on the range residuals. See NOTE 14 below. */
+void trilaterate(const Anchor *set, int n)
 {
-	float A = 2*(A2.x - A1.x);
-	float B = 2*(A2.y - A2.y);
-	float C = ((pow(A1.distance, 2.0)) - (pow(A2.distance, 2.0)) - (pow(A1.x, 2.0)) + (pow(A2.x, 2.0)) - (pow(A1.y, 2.0)) + (pow(A2.y, 2.0)));
-	float D = 2*(A3.x - A2.x);
-	float E = 2*(A3.y = A2.y);
-	float F = (pow(A2.distance, 2.0) - pow(A3.distance, 2.0) - pow(A2.x, 2.0) + pow(A3.x, 2.0) - pow(A2.y, 2.0) + pow(A3.y, 2.0));
-
-	if( ((B * D) - (E * A))==0  || ((A * E) - (D * B))==0)
+	static Position last_pos;
+	static int have_fix = 0;
+	Position pos;
+
+	if (trilat_solve(set, n, &pos) != 0)
+	{
+		/* Collinear or degenerate geometry: warm start from the previous fix. */
+		if (!have_fix)
+			return;
+		pos = last_pos;
+	}
+	if (trilat_refine(set, n, &pos) < 0)
 		return;
+	last_pos = pos;
+	have_fix = 1;
+	pos.z = 0.0;
+	report_position(set, n, &pos);
 
-	float x = ( (F * B) - (E * C)) / ((B * D) - (E * A));
-	float y = ( (F * A) - (D * C)) / ((A * E) - (D * B));
-	//memcpy(arr1,&x,sizeof(x));
-	//memcpy(arr2,&y,sizeof(y));
-	sprintf(&arr1[2], "%f\n",x);
-	sprintf(&arr2[2], "%f\n",y);
+	sprintf((char *)&arr1[2], "%f\n",pos.x);
+	sprintf((char *)&arr2[2], "%f\n",pos.y);
 
 	test_run_info(arr1);
 	Sleep(10);
-    //CDC_Transmit_FS((uint8_t *)"\n", 1); /*Transmit end of line through USB - Virtual port*/
-	//Sleep(10);
 	test_run_info(arr2);
-	//Sleep(10);
-	//CDC_Transmit_FS((uint8_t *)"\n", 1); /*Transmit end of line through USB - Virtual port*/
 }
 
 /* Delay between frames, in UWB microseconds. See NOTE 1 below. */
@@ -167,14 +327,68 @@ extern dwt_txconfig_t txconfig_options;
  *
  * @return none
  */
-Anchor A1={2,1,0};
-Anchor A2={3,6,0};
-Anchor A3={7,4,0};
+Anchor A1={2,1,0,0,0,1};
+Anchor A2={3,6,0,0,0,1};
+Anchor A3={7,4,0,0,0,1};
+
+/* Newest distance frame received from each peer, and bit i set while the distance of anchor i is newer than the last fix. See NOTE 18
+ * below. */
+static seq_track_t dist_seq;
+static uint8_t dist_fresh = 0;
+/* Time each of those distances was received, and how far apart they may be for a fix: the initiator ranges one anchor every
+ * RNG_DELAY_MS (1 s). See NOTE 19 below. */
+#define DIST_ALIGN_WINDOW_MS 100
+#define DIST_ALIGN_EXTRAP_MS 2500
+static range_stamp_t dist_stamp[3];
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn dist_update()
+ *
+ * @brief Take the distance of a distance frame if it is one, sent by the anchor just answered, and newer than any before from it; any other
+ *        frame, or a duplicate, reordered or stale one, is dropped. See NOTE 18 below. Call it right after reading the frame: the distance is
+ *        stamped with the frame's RX time.
+ *
+ * @param  i      index of the anchor, 0 to 2
+ * @param  a      the anchor
+ * @param  poll   poll template of the anchor, whose source the frame must have
+ * @param  frame  frame received, its checksum overwritten
+ * @param  len    its length
+ *
+ * @return none
+ */
+static void dist_update(int i, Anchor *a, const uint8_t *poll, uint8_t *frame, uint16_t len)
+{
+    if (len != DIST_MSG_LEN || frame[ALL_MSG_COMMON_LEN - 1] != DIST_MSG_FCODE || frame[7] != poll[7] || frame[8] != poll[8])
+        return;
+    if (seq_track_check(&dist_seq, frame[7] | (frame[8] << 8), frame[ALL_MSG_SN_IDX], portGetTickCnt()) != SEQ_NEW)
+        return;
+    frame[DIST_MSG_LEN - 2] = '\0'; /* The text ends at the checksum at the latest. */
+    a->distance = str_to_float((char *)&frame[DIST_MSG_TXT_IDX]);
+    dist_fresh |= (uint8_t)(1 << i);
+    range_stamp(&dist_stamp[i], a->distance, get_rx_timestamp_u64(), portGetTickCnt(), 0);
+}
+
 void tril_do(){
     /********************************************************************************************/
-	if((A1.distance>0) && (A2.distance>0) && (A3.distance>0))
+	/* Only a new distance from each anchor makes a fix, and each is used once. */
+	if((dist_fresh == 0x07) && (A1.distance>0) && (A2.distance>0) && (A3.distance>0))
 	{
-		trilaterate(A1,A2,A3);
+		Anchor set[3];
+		double dist[3];
+		uint8_t keep[3];
+
+		set[0] = A1;
+		set[1] = A2;
+		set[2] = A3;
+		/* The three were received at different times: bring them to the newest, or give up this fix. See NOTE 19 below. */
+		if (range_align(dist_stamp, 3, DIST_ALIGN_WINDOW_MS, DIST_ALIGN_EXTRAP_MS, dist, keep) == 3)
+		{
+			set[0].distance = dist[0];
+			set[1].distance = dist[1];
+			set[2].distance = dist[2];
+			trilaterate(set, 3);
+		}
+		dist_fresh = 0;
 	}
     //Sleep(2);
     /******************************************************************************************************/
@@ -216,21 +430,43 @@ int ss_twr_responder(void)
     /* Configure the TX spectrum parameters (power, PG delay and PG count) */
     dwt_configuretxrf(&txconfig_options);
 
-    /* Apply default antenna delay value. See NOTE 2 below. */
-    dwt_setrxantennadelay(RX_ANT_DLY);
-    dwt_settxantennadelay(TX_ANT_DLY);
+    /* Apply calibrated antenna delay value if one is stored in OTP, default value otherwise. See NOTE 2 below. */
+    ant_cal_load(&tx_ant_dly, &rx_ant_dly);
+    dwt_setrxantennadelay(rx_ant_dly);
+    dwt_settxantennadelay(tx_ant_dly);
 
     /* Next can enable TX/RX states output on GPIOs 5 and 6 to help debug, and also TX/RX LEDs
      * Note, in real low power applications the LEDs should not be used. */
     dwt_setlnapamode(DWT_LNA_ENABLE | DWT_PA_ENABLE);
+
+    seq_track_init(&dist_seq);
+
+    /* Aggregated position reports to the gateway. See NOTE 15 below. */
+    report_agg_init(&report, report_buf, sizeof(report_buf), REPORT_GATEWAY_ADDR, REPORT_OWN_ADDR, REPORT_AGG_MAX_AGE_MS);
+#ifdef REPORT_MESH
+    {
+        mesh_cfg_t mesh_cfg = { REPORT_OWN_ADDR, MESH_PARENT_ADDR, MESH_OWN_SLOT };
+        mesh_init(&mesh_cfg);
+    }
+#endif
 	Anchor *Anchor_identifier;
     while (1)
     {
+#ifdef REPORT_MESH
+        /* Send the queued reports in this anchor's slot, and listen no longer than the start of the next one. See NOTE 17 below. */
+        mesh_slot(portGetTickCnt());
+        dwt_setrxtimeout(mesh_wait_ms(portGetTickCnt()) * 1000);
+#else
+        /* With something to send, listen for IDLE_LISTEN_UUS only: a timeout means the channel is quiet. See NOTE 16 below. */
+        dwt_setrxtimeout(idle_pending() ? IDLE_LISTEN_UUS : 0);
+#endif
         /* 즉시 RX 가능하게끔 활성화함. */
         dwt_rxenable(DWT_START_RX_IMMEDIATE);
 
         /* Poll for reception of a frame or error/timeout. See NOTE 6 below. */
-        waitforsysstatus(&status_reg, NULL, (DWT_INT_RXFCG_BIT_MASK | SYS_STATUS_ALL_RX_ERR), 0);
+        waitforsysstatus(&status_reg, NULL, (DWT_INT_RXFCG_BIT_MASK | SYS_STATUS_ALL_RX_TO | SYS_STATUS_ALL_RX_ERR), 0);
+        /* The exchange itself waits without a timeout. */
+        dwt_setrxtimeout(0);
 
         if (status_reg & DWT_INT_RXFCG_BIT_MASK)
         {
@@ -261,7 +497,7 @@ int ss_twr_responder(void)
                     dwt_setdelayedtrxtime(resp_tx_time);
 
                     /* Response TX timestamp is the transmission time we programmed plus the antenna delay. */
-                    resp_tx_ts = (((uint64_t)(resp_tx_time & 0xFFFFFFFEUL)) << 8) + TX_ANT_DLY;
+                    resp_tx_ts = (((uint64_t)(resp_tx_time & 0xFFFFFFFEUL)) << 8) + tx_ant_dly;
 
                     /* Write all timestamps in the final message. See NOTE 8 below. */
                     resp_msg_set_ts(&tx_resp_msg1[RESP_MSG_POLL_RX_TS_IDX], poll_rx_ts);
@@ -296,11 +532,7 @@ int ss_twr_responder(void)
                         {
                             dwt_readrxdata(buff, frame_len, 0);
                             Anchor_identifier = &A1;
-                            buff[14] = '\0'; //Checksum 값 초기화
-                            buff[15] = '\0'; //Checksum 값 초기화
-                            float buf=str_to_float(buff);
-
-                			Anchor_identifier->distance = buf;
+                			dist_update(0, Anchor_identifier, rx_poll_msg1, buff, frame_len);
                 			//test_run_info(buff);
                         }
                     }
@@ -318,7 +550,7 @@ int ss_twr_responder(void)
                     dwt_setdelayedtrxtime(resp_tx_time);
 
                     /* Response TX timestamp is the transmission time we programmed plus the antenna delay. */
-                    resp_tx_ts = (((uint64_t)(resp_tx_time & 0xFFFFFFFEUL)) << 8) + TX_ANT_DLY;
+                    resp_tx_ts = (((uint64_t)(resp_tx_time & 0xFFFFFFFEUL)) << 8) + tx_ant_dly;
 
                     /* Write all timestamps in the final message. See NOTE 8 below. */
                     resp_msg_set_ts(&tx_resp_msg2[RESP_MSG_POLL_RX_TS_IDX], poll_rx_ts);
@@ -353,11 +585,7 @@ int ss_twr_responder(void)
                         {
                             dwt_readrxdata(buff, frame_len, 0);
                             Anchor_identifier = &A2;
-                            buff[14] = '\0'; //Checksum 값 초기화
-                            buff[15] = '\0'; //Checksum 값 초기화
-                            float buf=str_to_float(buff);
-
-                			Anchor_identifier->distance = buf;
+                			dist_update(1, Anchor_identifier, rx_poll_msg2, buff, frame_len);
                 			//test_run_info(buff);
                         }
                     }
@@ -375,7 +603,7 @@ int ss_twr_responder(void)
                     dwt_setdelayedtrxtime(resp_tx_time);
 
                     /* Response TX timestamp is the transmission time we programmed plus the antenna delay. */
-                    resp_tx_ts = (((uint64_t)(resp_tx_time & 0xFFFFFFFEUL)) << 8) + TX_ANT_DLY;
+                    resp_tx_ts = (((uint64_t)(resp_tx_time & 0xFFFFFFFEUL)) << 8) + tx_ant_dly;
 
                     /* Write all timestamps in the final message. See NOTE 8 below. */
                     resp_msg_set_ts(&tx_resp_msg3[RESP_MSG_POLL_RX_TS_IDX], poll_rx_ts);
@@ -410,11 +638,7 @@ int ss_twr_responder(void)
                         {
                             dwt_readrxdata(buff, frame_len, 0);
                             Anchor_identifier = &A3;
-                            buff[14] = '\0'; //Checksum 값 초기화
-                            buff[15] = '\0'; //Checksum 값 초기화
-                            float buf=str_to_float(buff);
-
-                			Anchor_identifier->distance = buf;
+                			dist_update(2, Anchor_identifier, rx_poll_msg3, buff, frame_len);
                 			//test_run_info(buff);
 
                         }
@@ -429,11 +653,25 @@ int ss_twr_responder(void)
 
 
             }
+#ifdef REPORT_MESH
+            else if (frame_len <= sizeof(mesh_buf))
+            {
+                const uint8_t *payload;
+                uint16_t plen;
+
+                /* Report from a child anchor: acknowledged and queued for the parent. */
+                dwt_readrxdata(mesh_buf, frame_len, 0);
+                mesh_rx(mesh_buf, frame_len, portGetTickCnt(), &payload, &plen);
+            }
+#endif
         }
         else
         {
-            /* Clear RX error events in the DW IC status register. */
-            dwt_writesysstatuslo(SYS_STATUS_ALL_RX_ERR);
+            /* Clear RX error/timeout events in the DW IC status register. */
+            dwt_writesysstatuslo(SYS_STATUS_ALL_RX_TO | SYS_STATUS_ALL_RX_ERR);
+            /* Nothing heard: the channel is quiet. See NOTE 16 below. */
+            if (status_reg & SYS_STATUS_ALL_RX_TO)
+                idle_send();
         }
     }
 }
@@ -511,4 +749,50 @@ int ss_twr_responder(void)
  *     thereafter.
  * 13. Desired configuration by user may be different to the current programmed configuration. dwt_configure is called to set desired
  *     configuration.
+ * 14. trilat_solve() (trilateration.c) gives a linear least squares position, which trilat_refine() then refines by minimising the range residuals
+ *     directly (Levenberg-Marquardt, at most TRILAT_REFINE_ITER iterations, usually one or two). The linear step loses accuracy with poor geometry
+ *     and fails when the anchors are collinear; in that case the previous fix is used as the starting point.
+ * 15. Each position is added to an aggregated report frame (report_agg.c) instead of being sent on its own: the tag address, a report sequence
+ *     number, a quality byte (from the RMS range residual) and x, y, z in centimetres, 10 bytes per position after an 11 byte header. The frame
+ *     is sent to the gateway when it is full (11 positions in a standard 127 byte frame, 99 with REPORT_BULK, see NOTE 16) or when its
+ *     oldest position is REPORT_AGG_MAX_AGE_MS old. Every position is appended, several of the same tag in order, so none is lost between
+ *     two frames and the gateway orders them by their sequence numbers. A device positioning itself often, or an anchor positioning many
+ *     tags, thus sends one uplink frame where it sent one per position. The frame is checked, and sent, from idle time (NOTE 16).
+ * 16. The ranging frames use the standard PHY header, which limits frames to 127 bytes. With REPORT_BULK defined, the report buffer is
+ *     BULK_CHUNK_MAX bytes (99 positions) and a report is sent by bulk_send() (bulk_xfer.c) in a frame of up to 1023 bytes, the PHY header
+ *     being switched to the extended mode (DWT_PHRMODE_EXT) for that transmission only; the header, preamble and turnaround overhead is paid
+ *     once for 99 positions instead of once for 11. A report is still sent once its oldest position is REPORT_AGG_MAX_AGE_MS old, so
+ *     positions reach the gateway as late as without REPORT_BULK, and a frame only fills up, and saves airtime, at more than 110 positions
+ *     per second: an anchor positioning many tags. A device positioning itself, a fix every few hundred milliseconds, sends the same
+ *     number of frames either way, longer ones in the extended mode, so REPORT_BULK is left undefined. With DIAG_DUMP defined, the first
+ *     DIAG_DUMP_TAPS taps of the CIR of the last frame received are read with dwt_readaccdata() every DIAG_DUMP_FIXES fixes and sent the
+ *     same way; at 1536 bytes it goes out in two chunks with sequence numbers, which the gateway reassembles. Every bulk_xfer.c data block is
+ *     cut into chunks like this, a receiver missing a chunk drops the whole block. A poll that comes in while this device transmits is lost,
+ *     so nothing is sent from the exchange itself: while a report or a dump is waiting, the loop listens for polls with an IDLE_LISTEN_UUS
+ *     timeout, and each timeout, a quiet channel between exchanges, sends one frame with idle_send() (the report once it is due, else the
+ *     next dump chunk) before listening again. The device is thus never more than one frame away from listening, and the timeout also
+ *     spaces the chunks by BULK_CHUNK_GAP_MS. Without REPORT_MESH the report's age is checked at each timeout, not only after a position.
+ * 17. With REPORT_MESH defined, an anchor out of the gateway's range sends its reports over other anchors (mesh_relay.c): each anchor has a
+ *     parent, MESH_PARENT_ADDR, on a routing tree fixed at installation whose root is the gateway, and a TDMA slot, MESH_OWN_SLOT, of a
+ *     MESH_SLOTS x MESH_SLOT_MS superframe. The slots of anchors in range of each other must differ. A report is queued by mesh_send() and
+ *     sent to the parent by mesh_slot() in this anchor's slot only; the parent acknowledges it at once and queues it in turn, or drops it if
+ *     it already has it, so a lost acknowledgement only costs a retry in the next slot. The loop now waits for polls with an RX timeout up
+ *     to the next slot when reports are queued, cleared once the poll is in so the ranging exchange is unchanged. The superframe is timed on
+ *     the parent's clock, read from its acknowledgements, so that all anchors follow the gateway's slots. A report takes up to one
+ *     superframe per hop, 80 ms by default, and holds REPORT_AGG_RECS(MESH_PAYLOAD_MAX) positions.
+ * 18. The distance frame that follows each exchange is checked by its sequence number, tracked for each sender (seq_track.c) with a window of
+ *     the last SEQ_WINDOW numbers, instead of being taken whatever it is: a duplicate, one received out of order or one older than the window
+ *     is dropped, so a value never replaces a newer one. The distance frame carries the header of the sender's poll, so its source address,
+ *     with function code DIST_MSG_FCODE and a sequence number the sender increments for each distance frame (initiator_ID_Filtering.c); a
+ *     frame of another length or function code, or from another source than the anchor just answered, is not a distance. A fix is only
+ *     computed once all three anchors have a distance newer than the last fix, and those distances are then used up: a distance left over
+ *     from an earlier round, when an anchor missed this one, never enters a fix with fresh ones. The polls are still matched without their
+ *     sequence number; answering a repeated poll costs one response and changes nothing.
+ * 19. The three distances of a fix come from three exchanges, each followed by its distance frame, and a tag that misses an anchor in one
+ *     round makes the others wait: they can be seconds apart. Each distance is stamped (range_align.c) with the DW IC system time its frame
+ *     was received at, and the tick count. Before solving they are taken to the time of the newest: within DIST_ALIGN_WINDOW_MS of it a
+ *     distance is used as it is, up to DIST_ALIGN_EXTRAP_MS it is moved along the range rate from that anchor's previous distances, and
+ *     older than that, or with no rate known yet (the first rounds), the fix is given up and the next round starts afresh. The limits suit
+ *     the 1 s between anchors of the initiator example; a faster initiator should tighten them. The receiver never sleeps, so all the
+ *     stamps are in one DW IC time base.
  ****************************************************************************************************************************************************/
@@ -0,0 +1,65 @@
+#include "tag_table.h"
+
+void tag_table_init(tag_table_t *t)
+{
+    t->n = 0;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn tag_table_seen()
+ *
+ * @brief Record a poll from a tag, adding it if it is new. With the table full the tag idle the longest is replaced.
+ *
+ * @param  t       table
+ * @param  addr    tag short address
+ * @param  now_ms  tick count
+ *
+ * @return the tag's entry
+ */
+tag_entry_t *tag_table_seen(tag_table_t *t, uint16_t addr, uint32_t now_ms)
+{
+    tag_entry_t *e;
+    int i, old = 0;
+
+    for (i = 0; i < t->n; i++)
+    {
+        if (t->e[i].addr == addr)
+        {
+            t->e[i].last_ms = now_ms;
+            t->e[i].polls++;
+            return &t->e[i];
+        }
+        if (now_ms - t->e[i].last_ms > now_ms - t->e[old].last_ms)
+            old = i;
+    }
+
+    e = (t->n < TAG_TABLE_LEN) ? &t->e[t->n++] : &t->e[old];
+    e->addr = addr;
+    e->last_ms = now_ms;
+    e->polls = 1;
+    return e;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn tag_table_expire()
+ *
+ * @brief Drop the tags that have not polled for TAG_TABLE_TIMEOUT_MS.
+ *
+ * @param  t       table
+ * @param  now_ms  tick count
+ *
+ * @return number of tags left
+ */
+int tag_table_expire(tag_table_t *t, uint32_t now_ms)
+{
+    int i = 0;
+
+    while (i < t->n)
+    {
+        if (now_ms - t->e[i].last_ms > TAG_TABLE_TIMEOUT_MS)
+            t->e[i] = t->e[--t->n];
+        else
+            i++;
+    }
+    return t->n;
+}
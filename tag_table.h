@@ -0,0 +1,33 @@
+/*! ----------------------------------------------------------------------------
+ *  @file    tag_table.h
+ *  @brief   Anchor-side state of the tags it serves
+ *
+ *           One entry per tag polling the anchor, with the time of its last poll. A tag that has not polled for TAG_TABLE_TIMEOUT_MS (moved to
+ *           another zone, switched off) is dropped, so the table only holds the tags actually served and its size bounds the state kept.
+ */
+#ifndef __TAG_TABLE_H__
+#define __TAG_TABLE_H__
+
+#include <stdint.h>
+
+#define TAG_TABLE_LEN        16
+#define TAG_TABLE_TIMEOUT_MS 5000
+
+typedef struct
+{
+    uint16_t addr;    /* Tag short address, as in the frames. */
+    uint32_t last_ms; /* Tick count of the last poll. */
+    uint32_t polls;   /* Polls since the entry was created. */
+} tag_entry_t;
+
+typedef struct
+{
+    tag_entry_t e[TAG_TABLE_LEN];
+    uint8_t n;
+} tag_table_t;
+
+void tag_table_init(tag_table_t *t);
+tag_entry_t *tag_table_seen(tag_table_t *t, uint16_t addr, uint32_t now_ms);
+int tag_table_expire(tag_table_t *t, uint32_t now_ms);
+
+#endif
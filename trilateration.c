@@ -0,0 +1,460 @@
+#include <math.h>
+#include "trilateration.h"
+
+/* Weight used for an anchor in the least squares problems. */
+static double anchor_weight(const Anchor *a)
+{
+    if (a->weight <= 0.0 || a->distance <= 0.0)
+        return 0.0;
+    return a->weight / (a->variance + TRILAT_VAR_FLOOR);
+}
+
+/* Weighted linear least squares over the anchors with a non-zero weight in w[]. */
+static int solve_weighted(const Anchor *a, int n, const double *w, Position *pos)
+{
+    double hxx = 0, hxy = 0, hyy = 0, gx = 0, gy = 0, det;
+    int ref = -1, used = 0, i;
+
+    for (i = 0; i < n; i++)
+    {
+        if (w[i] > 0.0)
+        {
+            used++;
+            if (ref < 0 || w[i] > w[ref])
+                ref = i;
+        }
+    }
+    if (used < 3)
+        return -1;
+
+    for (i = 0; i < n; i++)
+    {
+        double ax, ay, b, wi;
+
+        if (i == ref || w[i] <= 0.0)
+            continue;
+
+        ax = 2.0 * (a[i].x - a[ref].x);
+        ay = 2.0 * (a[i].y - a[ref].y);
+        b = a[ref].distance * a[ref].distance - a[i].distance * a[i].distance
+            - a[ref].x * a[ref].x + a[i].x * a[i].x - a[ref].y * a[ref].y + a[i].y * a[i].y;
+        wi = w[i] * w[ref] / (w[i] + w[ref]);
+
+        hxx += wi * ax * ax;
+        hxy += wi * ax * ay;
+        hyy += wi * ay * ay;
+        gx += wi * ax * b;
+        gy += wi * ay * b;
+    }
+
+    det = hxx * hyy - hxy * hxy;
+    if (fabs(det) <= 1e-9 * (hxx * hyy + 1e-12))
+        return -1;
+
+    pos->x = (hyy * gx - hxy * gy) / det;
+    pos->y = (hxx * gy - hxy * gx) / det;
+    return 0;
+}
+
+/* Range residual of an anchor at a position, in metres, in the plane or in 3D. */
+static double residual_dim(const Anchor *a, const Position *pos, int dims)
+{
+    double dz = (dims == 3) ? pos->z - a->z : 0.0;
+
+    return sqrt((pos->x - a->x) * (pos->x - a->x) + (pos->y - a->y) * (pos->y - a->y) + dz * dz) - a->distance;
+}
+
+static double residual(const Anchor *a, const Position *pos)
+{
+    return residual_dim(a, pos, 2);
+}
+
+/* Solve h * x = g for a symmetric 3x3 h by Cramer's rule. */
+static int solve3(double h[3][3], const double g[3], double x[3])
+{
+    double c00 = h[1][1] * h[2][2] - h[1][2] * h[2][1];
+    double c01 = h[1][2] * h[2][0] - h[1][0] * h[2][2];
+    double c02 = h[1][0] * h[2][1] - h[1][1] * h[2][0];
+    double det = h[0][0] * c00 + h[0][1] * c01 + h[0][2] * c02;
+
+    if (fabs(det) <= 1e-9 * fabs(h[0][0] * h[1][1] * h[2][2]) || det == 0.0)
+        return -1;
+
+    x[0] = (g[0] * c00 + h[0][1] * (g[2] * h[1][2] - g[1] * h[2][2]) + h[0][2] * (g[1] * h[2][1] - g[2] * h[1][1])) / det;
+    x[1] = (h[0][0] * (g[1] * h[2][2] - g[2] * h[1][2]) + g[0] * c01 + h[0][2] * (g[2] * h[1][0] - g[1] * h[2][0])) / det;
+    x[2] = (h[0][0] * (g[2] * h[1][1] - g[1] * h[2][1]) + h[0][1] * (g[1] * h[2][0] - g[2] * h[1][0]) + g[0] * c02) / det;
+    return 0;
+}
+
+/* Levenberg-Marquardt on the range residuals, in the plane (dims 2, z untouched) or in 3D (dims 3). */
+static int refine(const Anchor *a, int n, Position *pos, int dims)
+{
+    double w[TRILAT_MAX_ANCHORS];
+    double lambda = TRILAT_LM_LAMBDA, cost = 0.0;
+    int used = 0, it, i;
+
+    if (n > TRILAT_MAX_ANCHORS)
+        n = TRILAT_MAX_ANCHORS;
+    for (i = 0; i < n; i++)
+    {
+        w[i] = anchor_weight(&a[i]);
+        if (w[i] > 0.0)
+        {
+            double r = residual_dim(&a[i], pos, dims);
+            cost += w[i] * r * r;
+            used++;
+        }
+    }
+    if (used < dims + 1)
+        return -1;
+
+    for (it = 1; it <= TRILAT_REFINE_ITER; it++)
+    {
+        double h[3][3] = { { 0 } }, g[3] = { 0 }, d[3], e[3], new_cost = 0.0;
+        Position cand;
+        int r, c;
+
+        /* Normal equations of the linearised residuals: J^T W J and J^T W r. */
+        for (i = 0; i < n; i++)
+        {
+            double range, res;
+
+            if (w[i] <= 0.0)
+                continue;
+            e[0] = pos->x - a[i].x;
+            e[1] = pos->y - a[i].y;
+            e[2] = (dims == 3) ? pos->z - a[i].z : 0.0;
+            range = sqrt(e[0] * e[0] + e[1] * e[1] + e[2] * e[2]);
+            if (range < 1e-6)
+                continue;
+            res = range - a[i].distance;
+            for (r = 0; r < 3; r++)
+            {
+                e[r] /= range;
+                g[r] += w[i] * e[r] * res;
+            }
+            for (r = 0; r < 3; r++)
+                for (c = 0; c < 3; c++)
+                    h[r][c] += w[i] * e[r] * e[c];
+        }
+        if (dims == 2)
+            h[2][2] = 1.0;
+
+        /* Damped step; the damping grows while steps are rejected and shrinks when they are accepted. */
+        for (r = 0; r < 3; r++)
+        {
+            h[r][r] *= 1.0 + lambda;
+            g[r] = -g[r];
+        }
+        if (solve3(h, g, d) != 0)
+            break;
+
+        cand.x = pos->x + d[0];
+        cand.y = pos->y + d[1];
+        cand.z = pos->z + d[2];
+        for (i = 0; i < n; i++)
+        {
+            if (w[i] > 0.0)
+            {
+                double res = residual_dim(&a[i], &cand, dims);
+                new_cost += w[i] * res * res;
+            }
+        }
+
+        if (new_cost <= cost)
+        {
+            *pos = cand;
+            cost = new_cost;
+            lambda *= 0.1;
+        }
+        else
+        {
+            lambda *= 10.0;
+        }
+        if (fabs(d[0]) + fabs(d[1]) + fabs(d[2]) < TRILAT_REFINE_EPS_M)
+            break;
+    }
+    return (it > TRILAT_REFINE_ITER) ? TRILAT_REFINE_ITER : it;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn trilat_solve()
+ *
+ * @brief Weighted linear least squares position. The range equation of a reference anchor (the one with the largest weight) is subtracted from
+ *        the others, which gives one linear equation per remaining anchor. Each equation is weighted by the combined weight of its two anchors.
+ *
+ * @param  a    anchors with their measured distances
+ * @param  n    number of anchors
+ * @param  pos  output, position
+ *
+ * @return 0 on success, -1 if fewer than 3 usable anchors or if they are collinear
+ */
+int trilat_solve(const Anchor *a, int n, Position *pos)
+{
+    double w[TRILAT_MAX_ANCHORS];
+    int i;
+
+    if (n > TRILAT_MAX_ANCHORS)
+        n = TRILAT_MAX_ANCHORS;
+    for (i = 0; i < n; i++)
+        w[i] = anchor_weight(&a[i]);
+    return solve_weighted(a, n, w, pos);
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn trilat_solve_robust()
+ *
+ * @brief Position that tolerates bad ranges when more than 3 anchors are available. Minimal subsets of 3 anchors are solved (at most
+ *        TRILAT_MAX_SUBSETS of them, so the run time is bounded, taken evenly over all the subsets so that every anchor is left out of some) and
+ *        the one agreeing with most anchors within TRILAT_INLIER_M is kept. The
+ *        inliers are then refined with Huber-weighted iterative reweighting (at most TRILAT_IRLS_ITER passes).
+ *
+ * @param  a        anchors with their measured distances
+ * @param  n        number of anchors
+ * @param  pos      output, position
+ * @param  inliers  output, bit i set if anchor i is consistent with the position (can be NULL)
+ *
+ * @return number of inliers, or -1 if no position could be computed
+ */
+int trilat_solve_robust(const Anchor *a, int n, Position *pos, uint32_t *inliers)
+{
+    double w[TRILAT_MAX_ANCHORS], wr[TRILAT_MAX_ANCHORS];
+    Position cand, best_pos;
+    double best_cost = 0.0;
+    uint32_t best_mask = 0;
+    int best_count = 0, subsets = 0, total, idx = 0, pick, it, i, j, k, m;
+
+    /* The 2D solves leave z alone: keep the caller's. */
+    cand = best_pos = *pos;
+    if (n > TRILAT_MAX_ANCHORS)
+        n = TRILAT_MAX_ANCHORS;
+    for (i = 0; i < n; i++)
+    {
+        w[i] = anchor_weight(&a[i]);
+        if (w[i] > 0.0)
+        {
+            best_mask |= 1u << i;
+            best_count++;
+        }
+    }
+
+    /* Without redundancy there is nothing to reject: plain least squares. */
+    if (best_count <= 3)
+    {
+        if (solve_weighted(a, n, w, pos) != 0)
+            return -1;
+        if (inliers)
+            *inliers = best_mask;
+        return best_count;
+    }
+    total = best_count * (best_count - 1) * (best_count - 2) / 6;
+    best_mask = 0;
+    best_count = 0;
+
+    /* Consensus over minimal subsets: all of them, or TRILAT_MAX_SUBSETS evenly spaced in their lexicographic order, first and last included. A
+     * cap on the first ones alone would keep anchor 0 in all of them. */
+    for (i = 0; i < n && subsets < TRILAT_MAX_SUBSETS; i++)
+    {
+        for (j = i + 1; j < n && subsets < TRILAT_MAX_SUBSETS; j++)
+        {
+            for (k = j + 1; k < n && subsets < TRILAT_MAX_SUBSETS; k++)
+            {
+                uint32_t mask = 0;
+                double cost = 0.0;
+                int count = 0;
+
+                if (w[i] <= 0.0 || w[j] <= 0.0 || w[k] <= 0.0)
+                    continue;
+                pick = (total <= TRILAT_MAX_SUBSETS) || (idx == subsets * (total - 1) / (TRILAT_MAX_SUBSETS - 1));
+                idx++;
+                if (!pick)
+                    continue;
+                for (m = 0; m < n; m++)
+                    wr[m] = (m == i || m == j || m == k) ? w[m] : 0.0;
+                subsets++;
+                if (solve_weighted(a, n, wr, &cand) != 0)
+                    continue;
+
+                for (m = 0; m < n; m++)
+                {
+                    double r;
+
+                    if (w[m] <= 0.0)
+                        continue;
+                    r = residual(&a[m], &cand);
+                    if (fabs(r) <= TRILAT_INLIER_M)
+                    {
+                        mask |= 1u << m;
+                        count++;
+                        cost += w[m] * r * r;
+                    }
+                }
+                if (count > best_count || (count == best_count && cost < best_cost))
+                {
+                    best_count = count;
+                    best_cost = cost;
+                    best_mask = mask;
+                    best_pos = cand;
+                }
+            }
+        }
+    }
+    if (best_count < 3)
+        return -1;
+
+    /* Huber-weighted refinement over the inliers. */
+    *pos = best_pos;
+    for (it = 0; it < TRILAT_IRLS_ITER; it++)
+    {
+        for (m = 0; m < n; m++)
+        {
+            double r = fabs(residual(&a[m], pos));
+
+            wr[m] = (best_mask & (1u << m)) ? w[m] : 0.0;
+            if (r > TRILAT_HUBER_M)
+                wr[m] *= TRILAT_HUBER_M / r;
+        }
+        if (solve_weighted(a, n, wr, &cand) != 0)
+            break;
+        if (fabs(cand.x - pos->x) + fabs(cand.y - pos->y) < 1e-3)
+        {
+            *pos = cand;
+            break;
+        }
+        *pos = cand;
+    }
+
+    if (inliers)
+        *inliers = best_mask;
+    return best_count;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn trilat_refine()
+ *
+ * @brief Nonlinear refinement of a position on the range residuals (Levenberg-Marquardt). The linear solvers square the ranges and subtract
+ *        equations, which amplifies noise with poor geometry; this minimises the weighted sum of squared range residuals directly. Started from
+ *        the linear solution or the previous fix it usually converges in one or two iterations. It stops after TRILAT_REFINE_ITER iterations or
+ *        when a step is shorter than TRILAT_REFINE_EPS_M.
+ *
+ * @param  a    anchors with their measured distances, anchors with a zero weight are ignored
+ * @param  n    number of anchors
+ * @param  pos  input, starting position; output, refined position
+ *
+ * @return number of iterations run, or -1 if fewer than 3 usable anchors (pos is then unchanged)
+ */
+int trilat_refine(const Anchor *a, int n, Position *pos)
+{
+    return refine(a, n, pos, 2);
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn trilat_solve_3d()
+ *
+ * @brief Weighted linear least squares position in 3D, as trilat_solve() with z. It needs at least 4 usable anchors that are not all in one plane;
+ *        anchors all mounted at the same height only give a usable z through trilat_refine_3d() from a starting point on the right side.
+ *
+ * @param  a    anchors with their measured distances
+ * @param  n    number of anchors
+ * @param  pos  output, position
+ *
+ * @return 0 on success, -1 if fewer than 4 usable anchors or if they are coplanar
+ */
+int trilat_solve_3d(const Anchor *a, int n, Position *pos)
+{
+    double w[TRILAT_MAX_ANCHORS], h[3][3] = { { 0 } }, g[3] = { 0 }, p[3];
+    int ref = -1, used = 0, i, r, c;
+
+    if (n > TRILAT_MAX_ANCHORS)
+        n = TRILAT_MAX_ANCHORS;
+    for (i = 0; i < n; i++)
+    {
+        w[i] = anchor_weight(&a[i]);
+        if (w[i] > 0.0)
+        {
+            used++;
+            if (ref < 0 || w[i] > w[ref])
+                ref = i;
+        }
+    }
+    if (used < 4)
+        return -1;
+
+    for (i = 0; i < n; i++)
+    {
+        double row[3], b, wi;
+
+        if (i == ref || w[i] <= 0.0)
+            continue;
+
+        row[0] = 2.0 * (a[i].x - a[ref].x);
+        row[1] = 2.0 * (a[i].y - a[ref].y);
+        row[2] = 2.0 * (a[i].z - a[ref].z);
+        b = a[ref].distance * a[ref].distance - a[i].distance * a[i].distance
+            - a[ref].x * a[ref].x + a[i].x * a[i].x - a[ref].y * a[ref].y + a[i].y * a[i].y - a[ref].z * a[ref].z + a[i].z * a[i].z;
+        wi = w[i] * w[ref] / (w[i] + w[ref]);
+
+        for (r = 0; r < 3; r++)
+        {
+            g[r] += wi * row[r] * b;
+            for (c = 0; c < 3; c++)
+                h[r][c] += wi * row[r] * row[c];
+        }
+    }
+
+    if (solve3(h, g, p) != 0)
+        return -1;
+    pos->x = p[0];
+    pos->y = p[1];
+    pos->z = p[2];
+    return 0;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn trilat_refine_3d()
+ *
+ * @brief As trilat_refine(), in 3D.
+ *
+ * @param  a    anchors with their measured distances, anchors with a zero weight are ignored
+ * @param  n    number of anchors
+ * @param  pos  input, starting position; output, refined position
+ *
+ * @return number of iterations run, or -1 if fewer than 4 usable anchors (pos is then unchanged)
+ */
+int trilat_refine_3d(const Anchor *a, int n, Position *pos)
+{
+    return refine(a, n, pos, 3);
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn trilat_project()
+ *
+ * @brief Known height (2.5D) support: convert the slant ranges to ranges in the horizontal plane of a tag at height z, so that the 2D solvers
+ *        (trilat_solve(), trilat_solve_robust(), trilat_refine()) give an unbiased x, y at the 2D cost. The variance is scaled with the
+ *        projection. A range shorter than the height difference (tag under the anchor, or noise) becomes TRILAT_MIN_HRANGE_M.
+ *
+ * @param  a    anchors with their measured slant distances
+ * @param  n    number of anchors
+ * @param  z    known height of the tag, in the anchors' frame
+ * @param  out  output, anchors with horizontal distances (can be the same array as a)
+ *
+ * @return none
+ */
+void trilat_project(const Anchor *a, int n, double z, Anchor *out)
+{
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        double dz = a[i].z - z;
+        double h2 = a[i].distance * a[i].distance - dz * dz;
+        double h = (h2 > TRILAT_MIN_HRANGE_M * TRILAT_MIN_HRANGE_M) ? sqrt(h2) : TRILAT_MIN_HRANGE_M;
+
+        out[i] = a[i];
+        if (a[i].distance <= 0.0)
+            continue;
+        /* d(h) = d(d) * d / h */
+        out[i].variance = a[i].variance * (a[i].distance * a[i].distance) / (h * h);
+        out[i].distance = h;
+    }
+}
@@ -0,0 +1,62 @@
+/*! ----------------------------------------------------------------------------
+ *  @file    trilateration.h
+ *  @brief   Position solvers shared by the tag and anchor examples
+ *
+ *           Anchor model and a weighted linear least squares position solver for any number of anchors. Each range is weighted by its quality
+ *           weight (e.g. the LOS/NLOS weight from nlos.c) over its variance (e.g. from a range burst). trilat_solve_robust() adds a bounded
+ *           consensus search over 3-anchor subsets so that one bad range does not corrupt the fix when more anchors are in range.
+ *           trilat_refine() polishes a position on the range residuals themselves.
+ *           The 2D solvers work in the x, y plane and ignore z. For anchors and tags at different heights either use trilat_project() with the
+ *           tag's known height (2.5D) before a 2D solver, or the 3D solvers.
+ */
+#ifndef __TRILATERATION_H__
+#define __TRILATERATION_H__
+
+#include <stdint.h>
+
+/* Maximum number of anchors handled by the solvers. */
+#define TRILAT_MAX_ANCHORS 16
+
+/* Floor added to the range variance when weighting, in square metres (10 cm standard deviation). */
+#define TRILAT_VAR_FLOOR 0.01
+
+/* Robust solver: maximum number of 3-anchor subsets tried, residual below which an anchor agrees with a subset (metres), number of reweighting
+ * passes and Huber threshold (metres). */
+#define TRILAT_MAX_SUBSETS 20
+#define TRILAT_INLIER_M    0.3
+#define TRILAT_IRLS_ITER   3
+#define TRILAT_HUBER_M     0.1
+
+/* Nonlinear refinement: iteration cap, step length below which it stops (metres) and initial Levenberg-Marquardt damping. */
+#define TRILAT_REFINE_ITER  5
+#define TRILAT_REFINE_EPS_M 0.001
+#define TRILAT_LM_LAMBDA    1e-3
+
+/* Smallest horizontal range given by trilat_project(), in metres. */
+#define TRILAT_MIN_HRANGE_M 0.05
+
+typedef struct Anchor
+{
+	double x;
+	double y;
+	double z;        /* Height, 0 for 2D use. */
+	double distance;
+	double variance; /* Variance of the distance, 0 if unknown. */
+	double weight;   /* Quality weight of the distance, 0 leaves the anchor out. */
+}Anchor;
+
+typedef struct Position
+{
+	double x;
+	double y;
+	double z;        /* Left unchanged by the 2D solvers. */
+}Position;
+
+int trilat_solve(const Anchor *a, int n, Position *pos);
+int trilat_solve_robust(const Anchor *a, int n, Position *pos, uint32_t *inliers);
+int trilat_refine(const Anchor *a, int n, Position *pos);
+int trilat_solve_3d(const Anchor *a, int n, Position *pos);
+int trilat_refine_3d(const Anchor *a, int n, Position *pos);
+void trilat_project(const Anchor *a, int n, double z, Anchor *out);
+
+#endif
@@ -0,0 +1,87 @@
+#include <deca_device_api.h>
+#include <deca_regs.h>
+#include <config_options.h>
+#include "zone.h"
+
+/* Zone 0 is the channel and code used before zones. The zones a tag moves between share channel 5 and differ by code only, so that every
+ * handover takes the fast path of zone_switch(). Codes 9 to 12 are all valid on both channels: a second group of zones on channel 9, with the
+ * same codes, can cover an area the tags do not walk into from these, or the same area for twice the capacity; the same code on channels 5
+ * and 9 does not matter, the bands do not overlap. */
+const zone_t zones[ZONE_NUM] = {
+    { 5, 9 },
+    { 5, 10 },
+    { 5, 11 },
+    { 5, 12 },
+};
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn zone_apply()
+ *
+ * @brief Set the channel and preamble codes of a zone in a configuration, before dwt_configure() (or dw_boot()).
+ *
+ * @param  cfg   configuration, the rest is left as it is
+ * @param  zone  zone number, below ZONE_NUM
+ *
+ * @return none
+ */
+void zone_apply(dwt_config_t *cfg, uint8_t zone)
+{
+    cfg->chan = zones[zone].chan;
+    cfg->txCode = zones[zone].code;
+    cfg->rxCode = zones[zone].code;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn zone_txrf()
+ *
+ * @brief TX spectrum settings (PG delay, power) for a channel, for dwt_configuretxrf().
+ *
+ * @param  chan  channel, 5 or 9
+ *
+ * @return settings for the channel
+ */
+dwt_txconfig_t *zone_txrf(uint8_t chan)
+{
+    return (chan == 9) ? &txconfig_options_ch9 : &txconfig_options;
+}
+
+/*! ------------------------------------------------------------------------------------------------------------------
+ * @fn zone_switch()
+ *
+ * @brief Move the DW IC to a zone at run time. Any TX/RX in progress is stopped. On the same channel only the preamble codes of CHAN_CTRL
+ *        are rewritten: the codes of the zones all have the 64 MHz PRF, so nothing else dwt_configure() sets depends on them. On another
+ *        channel the configuration is applied again with dwt_configure() and the channel's TX spectrum, which relocks the PLL and recalibrates
+ *        the receiver and takes far longer: the zone table keeps neighbouring zones on one channel so that only a move between channel groups
+ *        goes this way. The settings written on top of dwt_configure() are kept. A device using dw_boot() must call dw_boot_invalidate() after a switch.
+ *
+ * @param  cfg   configuration in use, updated
+ * @param  zone  zone number, below ZONE_NUM
+ *
+ * @return DWT_SUCCESS, or DWT_ERROR if dwt_configure() failed
+ */
+int zone_switch(dwt_config_t *cfg, uint8_t zone)
+{
+    const zone_t *z = &zones[zone];
+    uint32_t chan_ctrl;
+
+    if (cfg->chan == z->chan && cfg->txCode == z->code && cfg->rxCode == z->code)
+        return DWT_SUCCESS;
+
+    dwt_forcetrxoff();
+    if (cfg->chan == z->chan)
+    {
+        chan_ctrl = dwt_read32bitoffsetreg(CHAN_CTRL_ID, 0);
+        chan_ctrl &= ~(uint32_t)(CHAN_CTRL_TX_PCODE_BIT_MASK | CHAN_CTRL_RX_PCODE_BIT_MASK);
+        chan_ctrl |= ((uint32_t)z->code << CHAN_CTRL_TX_PCODE_BIT_OFFSET) | ((uint32_t)z->code << CHAN_CTRL_RX_PCODE_BIT_OFFSET);
+        dwt_write32bitoffsetreg(CHAN_CTRL_ID, 0, chan_ctrl);
+        cfg->txCode = z->code;
+        cfg->rxCode = z->code;
+        return DWT_SUCCESS;
+    }
+
+    zone_apply(cfg, zone);
+    if (dwt_configure(cfg))
+        return DWT_ERROR;
+    dwt_configuretxrf(zone_txrf(z->chan));
+    return DWT_SUCCESS;
+}
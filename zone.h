@@ -0,0 +1,31 @@
+/*! ----------------------------------------------------------------------------
+ *  @file    zone.h
+ *  @brief   Zones: tag populations partitioned by UWB channel and preamble code
+ *
+ *           Each zone runs on its own channel (5 or 9) and preamble code, so that the exchanges of different zones do not collide and the
+ *           zones' capacities add up. An anchor belongs to one zone, set at start-up; a tag works in one zone at a time and switches with
+ *           zone_switch(). Between zones on the same channel only the preamble code changes, which is one register write; a change of channel
+ *           needs the PLL relocked and the receiver recalibrated, which dwt_configure() does. Neighbouring zones are therefore put on the
+ *           same channel with different codes, and channels separate groups of zones: only a move between groups is slow.
+ */
+#ifndef __ZONE_H__
+#define __ZONE_H__
+
+#include <stdint.h>
+#include <deca_device_api.h>
+
+#define ZONE_NUM 4
+
+typedef struct
+{
+    uint8_t chan; /* UWB channel, 5 or 9. */
+    uint8_t code; /* Preamble code, TX and RX, 9 to 12 (64 MHz PRF). */
+} zone_t;
+
+extern const zone_t zones[ZONE_NUM];
+
+void zone_apply(dwt_config_t *cfg, uint8_t zone);
+int zone_switch(dwt_config_t *cfg, uint8_t zone);
+dwt_txconfig_t *zone_txrf(uint8_t chan);
+
+#endif